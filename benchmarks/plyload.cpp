@@ -0,0 +1,148 @@
+// Load-time comparison of the bulk PLY readers against the per-value
+// ones, for the binary body and its ASCII conversion, followed by the cost
+// and effect of the optional mesh optimization. Without a file a grid
+// mesh of the given resolution is generated in memory.
+//
+//   $ ./plyload [file.ply | grid:<resolution>] [repeats]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "tinyply.h"
+#include "meshoptimizer.h"
+
+struct Mesh {
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<uint8_t> colors;
+    std::vector<uint32_t> indices;
+
+    bool operator==(const Mesh &m) const {
+        return positions == m.positions && normals == m.normals &&
+               colors == m.colors && indices == m.indices;
+    }
+};
+
+std::string save(Mesh &mesh, bool binary) {
+    tinyply::PlyFile file;
+    file.add_properties_to_element("vertex", { "x", "y", "z" }, mesh.positions);
+    file.add_properties_to_element("vertex", { "nx", "ny", "nz" }, mesh.normals);
+    file.add_properties_to_element("vertex", { "red", "green", "blue", "alpha" }, mesh.colors);
+    file.add_properties_to_element("face", { "vertex_indices" }, mesh.indices, 3, tinyply::PlyProperty::Type::UINT8);
+
+    std::ostringstream os;
+    file.write(os, binary);
+    return os.str();
+}
+
+Mesh makeGrid(int res) {
+    Mesh mesh;
+    for (int y = 0; y <= res; y++) {
+        for (int x = 0; x <= res; x++) {
+            mesh.positions.insert(mesh.positions.end(), { (float)x / res, (float)y / res, 0.0f });
+            mesh.normals.insert(mesh.normals.end(), { 0.0f, 0.0f, 1.0f });
+            mesh.colors.insert(mesh.colors.end(), { (uint8_t)x, (uint8_t)y, 0, 255 });
+        }
+    }
+
+    for (int y = 0; y < res; y++) {
+        for (int x = 0; x < res; x++) {
+            const uint32_t i = y * (res + 1) + x;
+            mesh.indices.insert(mesh.indices.end(), { i, i + 1, i + res + 2 });
+            mesh.indices.insert(mesh.indices.end(), { i, i + res + 2, i + res + 1 });
+        }
+    }
+    return mesh;
+}
+
+Mesh load(const std::string &data, bool bulk) {
+    std::istringstream is(data);
+    tinyply::PlyFile file(is);
+
+    Mesh mesh;
+    file.request_properties_from_element("vertex", { "x", "y", "z" }, mesh.positions);
+    file.request_properties_from_element("vertex", { "nx", "ny", "nz" }, mesh.normals);
+    file.request_properties_from_element("vertex", { "red", "green", "blue", "alpha" }, mesh.colors);
+    file.request_properties_from_element("face", { "vertex_indices" }, mesh.indices);
+    file.read(is, bulk);
+    return mesh;
+}
+
+double timeLoad(const std::string &data, bool bulk, int repeats, Mesh *mesh) {
+    double best = 1.0e20;
+    for (int i = 0; i < repeats; i++) {
+        const auto start = std::chrono::steady_clock::now();
+        *mesh = load(data, bulk);
+        const auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+bool compare(const char *label, const std::string &data, int repeats) {
+    Mesh scalar, bulk;
+    const double scalarMs = timeLoad(data, false, repeats, &scalar);
+    const double bulkMs = timeLoad(data, true, repeats, &bulk);
+
+    printf("%-8s %8.1f MB  per-value %9.2f ms  bulk %9.2f ms  (x%.1f)\n", label,
+           data.size() / (1024.0 * 1024.0), scalarMs, bulkMs, scalarMs / bulkMs);
+
+    if (!(scalar == bulk)) {
+        std::cerr << "[ERROR] readers disagree on " << label << " data" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void optimize(const Mesh &mesh) {
+    const size_t vertexCount = mesh.positions.size() / 3;
+    std::vector<uint32_t> indices = mesh.indices;
+    std::vector<uint32_t> cacheOrder(indices.size());
+
+    const VertexCacheStats before = analyzeVertexCache(indices.data(), indices.size(), vertexCount);
+    const auto start = std::chrono::steady_clock::now();
+    optimizeVertexCache(cacheOrder.data(), indices.data(), indices.size(), vertexCount);
+    optimizeOverdraw(indices.data(), cacheOrder.data(), indices.size(),
+                     (const uint8_t *)mesh.positions.data(), 3 * sizeof(float), vertexCount);
+    optimizeVertexFetch(indices.data(), indices.size(), vertexCount);
+    const auto end = std::chrono::steady_clock::now();
+    const VertexCacheStats after = analyzeVertexCache(indices.data(), indices.size(), vertexCount);
+
+    printf("optimize %9.2f ms  ACMR %.3f -> %.3f  ATVR %.3f -> %.3f\n",
+           std::chrono::duration<double, std::milli>(end - start).count(),
+           before.acmr, after.acmr, before.atvr, after.atvr);
+}
+
+int main(int argc, char **argv) {
+    const std::string source = argc > 1 ? argv[1] : "grid:1000";
+    const int repeats = argc > 2 ? std::atoi(argv[2]) : 5;
+
+    Mesh mesh;
+    if (source.compare(0, 5, "grid:") == 0) {
+        mesh = makeGrid(std::atoi(source.c_str() + 5));
+    } else {
+        std::ifstream ifs(source.c_str(), std::ios::in | std::ios::binary);
+        if (!ifs.is_open()) {
+            std::cerr << "[ERROR] failed to open file: " << source << std::endl;
+            return 1;
+        }
+        std::ostringstream ss;
+        ss << ifs.rdbuf();
+        mesh = load(ss.str(), true);
+    }
+
+    printf("vertices:  %zu\n", mesh.positions.size() / 3);
+    printf("triangles: %zu\n", mesh.indices.size() / 3);
+
+    bool agree = compare("binary", save(mesh, true), repeats);
+    agree = compare("ascii", save(mesh, false), repeats) && agree;
+    optimize(mesh);
+    return agree ? 0 : 1;
+}
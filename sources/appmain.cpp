@@ -1,4 +1,5 @@
 #include <QtWidgets/qapplication.h>
+#include <QtCore/qcommandlineparser.h>
 #include <QtGui/qsurfaceformat.h>
 
 #include "maingui.h"
@@ -6,13 +7,22 @@
 int main(int argc, char** argv) {
     QApplication app(argc, argv);
 
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Shadow mapping techniques viewer");
+    parser.addHelpOption();
+    RenderSettings::addOptions(parser);
+    parser.process(app);
+
+    RenderSettings settings;
+    settings.parse(parser);
+
     QSurfaceFormat format = QSurfaceFormat::defaultFormat();
     format.setVersion(3, 3);
     format.setProfile(QSurfaceFormat::CoreProfile);
     format.setOption(QSurfaceFormat::DeprecatedFunctions, false);
     QSurfaceFormat::setDefaultFormat(format);
     
-    MainGUI gui;
+    MainGUI gui(settings);
     gui.showMaximized();
 
     return app.exec();
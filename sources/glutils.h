@@ -6,25 +6,66 @@
 #define _GL_UTILS_H_
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <string>
+#include <vector>
 #include <memory>
 
 #include <QtGui/qopenglshaderprogram.h>
+#include <QtGui/qopenglcontext.h>
+#include <QtGui/qopenglfunctions_3_3_core.h>
+
+inline QOpenGLFunctions_3_3_Core *glCoreFunctions() {
+    return QOpenGLContext::currentContext()->versionFunctions<QOpenGLFunctions_3_3_Core>();
+}
+
+// Reads a shader source, expanding #include "file" directives relative to
+// the including file and inserting the given #defines after #version.
+inline std::string loadShaderSource(const std::string& filename,
+                                    const std::vector<std::string>& defines = {}) {
+    std::ifstream ifs(filename.c_str(), std::ios::in);
+    if (!ifs.is_open()) {
+        std::cerr << "[ERROR] failed to open shader file: " << filename << std::endl;
+        return "";
+    }
+
+    const std::string dirname = filename.substr(0, filename.find_last_of("/\\") + 1);
+
+    std::ostringstream oss;
+    std::string line;
+    while (std::getline(ifs, line)) {
+        if (line.compare(0, 8, "#include") == 0) {
+            const size_t first = line.find('"');
+            const size_t last = line.find_last_of('"');
+            oss << loadShaderSource(dirname + line.substr(first + 1, last - first - 1)) << "\n";
+            continue;
+        }
+
+        oss << line << "\n";
+        if (line.compare(0, 8, "#version") == 0) {
+            for (const auto& def : defines) {
+                oss << "#define " << def << "\n";
+            }
+        }
+    }
+    return oss.str();
+}
 
 inline std::unique_ptr<QOpenGLShaderProgram>
-    compileShader(const std::string& name, bool useGeom = false) {
+    compileShader(const std::string& name, bool useGeom = false,
+                  const std::vector<std::string>& defines = {}) {
 
     auto shader = std::make_unique<QOpenGLShaderProgram>();
-    const QString basename(name.c_str());
 
-    shader->addShaderFromSourceFile(QOpenGLShader::Vertex,
-                                    basename + ".vs");
+    shader->addShaderFromSourceCode(QOpenGLShader::Vertex,
+                                    loadShaderSource(name + ".vs", defines).c_str());
     if (useGeom) {
-        shader->addShaderFromSourceFile(QOpenGLShader::Geometry,
-                                        basename + ".gs");
+        shader->addShaderFromSourceCode(QOpenGLShader::Geometry,
+                                        loadShaderSource(name + ".gs", defines).c_str());
     }
-    shader->addShaderFromSourceFile(QOpenGLShader::Fragment,
-                                    basename + ".fs");
+    shader->addShaderFromSourceCode(QOpenGLShader::Fragment,
+                                    loadShaderSource(name + ".fs", defines).c_str());
 
     shader->link();
     if (!shader->isLinked()) {
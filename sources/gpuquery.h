@@ -0,0 +1,80 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _GPU_QUERY_H_
+#define _GPU_QUERY_H_
+
+#include <vector>
+
+#include "glutils.h"
+
+// Asynchronous query over a small ring of query objects. Results are
+// collected a few frames later, so reading them never stalls the GPU.
+// A value known when the query ends, such as what it was issued for, can
+// be passed to end() and is returned with that query's result.
+class GpuQuery {
+public:
+    explicit GpuQuery(GLenum target, int latency = 4)
+        : target_(target)
+        , queries_(latency, 0)
+        , issued_(latency, false)
+        , tags_(latency, 0) {
+    }
+
+    void begin() {
+        auto f = glCoreFunctions();
+        if (queries_[0] == 0) {
+            f->glGenQueries((GLsizei)queries_.size(), &queries_[0]);
+        }
+
+        collect(f, current_);
+        f->glBeginQuery(target_, queries_[current_]);
+    }
+
+    void end(GLuint64 tag = 0) {
+        glCoreFunctions()->glEndQuery(target_);
+        issued_[current_] = true;
+        tags_[current_] = tag;
+        current_ = (current_ + 1) % (int)queries_.size();
+    }
+
+    void release() {
+        if (queries_[0] == 0) return;
+
+        glCoreFunctions()->glDeleteQueries((GLsizei)queries_.size(), &queries_[0]);
+        std::fill(queries_.begin(), queries_.end(), 0);
+        std::fill(issued_.begin(), issued_.end(), false);
+        hasResult_ = false;
+    }
+
+    // Latest completed result, and the tag its query was ended with
+    inline bool hasResult() const { return hasResult_; }
+    inline GLuint64 result() const { return result_; }
+    inline GLuint64 resultTag() const { return resultTag_; }
+
+private:
+    void collect(QOpenGLFunctions_3_3_Core *f, int slot) {
+        if (!issued_[slot]) return;
+
+        GLint available = 0;
+        f->glGetQueryObjectiv(queries_[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            f->glGetQueryObjectui64v(queries_[slot], GL_QUERY_RESULT, &result_);
+            resultTag_ = tags_[slot];
+            hasResult_ = true;
+        }
+        issued_[slot] = false;
+    }
+
+    GLenum target_;
+    std::vector<GLuint> queries_;
+    std::vector<bool> issued_;
+    std::vector<GLuint64> tags_;
+    int current_ = 0;
+    GLuint64 result_ = 0;
+    GLuint64 resultTag_ = 0;
+    bool hasResult_ = false;
+};
+
+#endif  // _GPU_QUERY_H_
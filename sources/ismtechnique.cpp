@@ -0,0 +1,234 @@
+#include "ismtechnique.h"
+
+#include <iostream>
+
+#include "common.h"
+#include "glutils.h"
+
+static const int ISM_TILE_SIZE = 64;
+static const float ismPointSize = 4.0f;
+static const float ismBias = 0.05f;
+
+void IsmTechnique::initialize(const RenderContext &ctx) {
+    initializeOpenGLFunctions();
+
+    rsm.initialize(ctx);
+    deferred = ctx.settings.deferred;
+    compileShaders();
+    createTargets(ctx);
+}
+
+void IsmTechnique::release() {
+    rsm.release();
+
+    vplShader.reset();
+    ismShader.reset();
+    ismRenderShader.reset();
+    shader.reset();
+
+    vplFbo.reset();
+    ismFbo.reset();
+    vplTargets.clear();
+    ismTargets.clear();
+    for (int i = 0; i < 2; i++) {
+        accumFbo[i].reset();
+        accumTexture[i].reset();
+    }
+    accumDepth.reset();
+    releaseGBuffer();
+}
+
+void IsmTechnique::compileShaders() {
+    const auto defines = rsm.shaderDefines();
+    auto sceneDefines = defines;
+    sceneDefines.push_back("ISM_INDIRECT");
+
+    shader = compileShader(std::string(SOURCE_DIRECTORY) + (deferred ? "shaders/deferred" : "shaders/render"),
+                           false, sceneDefines);
+    vplShader = compileShader(std::string(SOURCE_DIRECTORY) + "shaders/vpl", false, defines);
+    ismShader = compileShader(std::string(SOURCE_DIRECTORY) + "shaders/ism", true);
+    ismRenderShader = compileShader(std::string(SOURCE_DIRECTORY) + "shaders/ismrender");
+}
+
+void IsmTechnique::createTargets(const RenderContext &ctx) {
+    createVplTargets(ctx);
+    createAccumTargets(ctx);
+}
+
+void IsmTechnique::createVplTargets(const RenderContext &ctx) {
+    vplFbo.reset();
+    ismFbo.reset();
+    vplTargets.clear();
+    ismTargets.clear();
+
+    ismRows = ctx.settings.vplCount / ISM_COLS;
+
+    // VPLs: one texel each, sampled from the RSM
+    vplTargets = {
+        ctx.targetPool->acquire(RenderTargetDesc::texture2D(ISM_COLS, ismRows, GL_RGBA32F)),
+        ctx.targetPool->acquire(RenderTargetDesc::texture2D(ISM_COLS, ismRows, GL_RGBA32F)),
+        ctx.targetPool->acquire(RenderTargetDesc::texture2D(ISM_COLS, ismRows, GL_RGBA32F))
+    };
+    vplFbo = std::make_unique<Framebuffer>(ISM_COLS, ismRows);
+    for (int i = 0; i < (int)vplTargets.size(); i++) {
+        vplFbo->attach(GL_COLOR_ATTACHMENT0 + i, *vplTargets[i]);
+    }
+    vplFbo->setDrawBuffers((int)vplTargets.size());
+
+    // ISM atlas: one tile per VPL
+    const int ismWidth = ISM_COLS * ISM_TILE_SIZE;
+    const int ismHeight = ismRows * ISM_TILE_SIZE;
+    ismTargets = {
+        ctx.targetPool->acquire(RenderTargetDesc::texture2D(ismWidth, ismHeight, GL_DEPTH_COMPONENT24)),
+        ctx.targetPool->acquire(RenderTargetDesc::texture2D(ismWidth, ismHeight, GL_R32F))
+    };
+    ismFbo = std::make_unique<Framebuffer>(ismWidth, ismHeight);
+    ismFbo->attach(GL_DEPTH_ATTACHMENT, *ismTargets[0]);
+    ismFbo->attach(GL_COLOR_ATTACHMENT0, *ismTargets[1]);
+    ismFbo->setDrawBuffers(1);
+
+    if (!vplFbo->isComplete() || !ismFbo->isComplete()) {
+        std::cerr << "[ERROR] ISM framebuffer is incomplete" << std::endl;
+    }
+
+    ctx.targetPool->trim();
+}
+
+void IsmTechnique::createAccumTargets(const RenderContext &ctx) {
+    const int width = ctx.viewport[2];
+    const int height = ctx.viewport[3];
+
+    for (int i = 0; i < 2; i++) {
+        accumFbo[i].reset();
+        accumTexture[i].reset();
+    }
+    accumDepth.reset();
+
+    // Screen-space ping-pong buffers for the row-by-row accumulation
+    accumDepth = ctx.targetPool->acquire(RenderTargetDesc::texture2D(width, height, GL_DEPTH_COMPONENT24));
+    for (int i = 0; i < 2; i++) {
+        accumTexture[i] = ctx.targetPool->acquire(RenderTargetDesc::texture2D(width, height, GL_RGBA16F));
+        accumFbo[i] = std::make_unique<Framebuffer>(width, height);
+        accumFbo[i]->attach(GL_DEPTH_ATTACHMENT, *accumDepth);
+        accumFbo[i]->attach(GL_COLOR_ATTACHMENT0, *accumTexture[i]);
+        accumFbo[i]->setDrawBuffers(1);
+    }
+
+    if (!accumFbo[0]->isComplete() || !accumFbo[1]->isComplete()) {
+        std::cerr << "[ERROR] ISM framebuffer is incomplete" << std::endl;
+    }
+
+    ctx.targetPool->trim();
+}
+
+void IsmTechnique::render(const RenderContext &ctx) {
+    const bool definesChanged = rsm.update(ctx);
+    if (definesChanged || deferred != ctx.settings.deferred) {
+        deferred = ctx.settings.deferred;
+        compileShaders();
+    }
+    if (ismRows != ctx.settings.vplCount / ISM_COLS) {
+        createVplTargets(ctx);
+    }
+    if (accumFbo[0]->width() != ctx.viewport[2] || accumFbo[0]->height() != ctx.viewport[3]) {
+        createAccumTargets(ctx);
+    }
+
+    rsm.renderShadowMap(ctx);
+    renderIsm(ctx);
+    updateGBuffer(ctx);
+
+    ctx.profiler->beginPass(deferred ? "lighting" : "scene");
+    glViewport(ctx.viewport[0], ctx.viewport[1], ctx.viewport[2], ctx.viewport[3]);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    shader->bind();
+    rsm.bindTextures(*shader);
+    setSceneUniforms(*shader, ctx);
+    glActiveTexture(GL_TEXTURE11);
+    glBindTexture(GL_TEXTURE_2D, accumTexture[ismRows % 2]->textureId());
+    shader->setUniformValue("u_indirectMap", 11);
+    if (deferred) {
+        drawDeferred(ctx, *shader);
+    } else {
+        drawScene(ctx, *shader);
+    }
+    shader->release();
+}
+
+void IsmTechnique::renderIsm(const RenderContext &ctx) {
+    // Sample VPLs from the RSM
+    ctx.profiler->beginPass("vpl");
+    glViewport(0, 0, ISM_COLS, ismRows);
+    glDisable(GL_DEPTH_TEST);
+    vplFbo->bind();
+    vplShader->bind();
+    rsm.bindTextures(*vplShader);
+    vplShader->setUniformValueArray("u_lightInvVpMat", &ctx.light.invVpMat()[0], 6);
+    vplShader->setUniformValue("u_ismCols", ISM_COLS);
+    drawFullScreen(ctx);
+    vplShader->release();
+    glEnable(GL_DEPTH_TEST);
+
+    for (int i = 0; i < 3; i++) {
+        glActiveTexture(GL_TEXTURE6 + i);
+        glBindTexture(GL_TEXTURE_2D, vplTargets[i]->textureId());
+    }
+
+    // Splat the point samples into the ISM atlas, one row of VPLs per draw
+    ctx.profiler->beginPass("ism splat");
+    const float maxDepth = 2.0f * ctx.scene->boundingRadius();
+    glViewport(0, 0, ismFbo->width(), ismFbo->height());
+    ismFbo->bind();
+    float far[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glClearBufferfv(GL_COLOR, 0, far);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    ismShader->bind();
+    ismShader->setUniformValue("u_vplPosition", 6);
+    ismShader->setUniformValue("u_vplNormal", 7);
+    ismShader->setUniformValue("u_ismRows", ismRows);
+    ismShader->setUniformValue("u_ismCols", ISM_COLS);
+    ismShader->setUniformValue("u_maxDepth", maxDepth);
+    ismShader->setUniformValue("u_pointSize", ismPointSize);
+    for (int row = 0; row < ismRows; row++) {
+        ismShader->setUniformValue("u_currentRow", row);
+        ctx.scene->drawPoints();
+    }
+    ismShader->release();
+    ismFbo->release();
+
+    // Accumulate indirect light row by row
+    ctx.profiler->beginPass("ism accumulate");
+    glActiveTexture(GL_TEXTURE9);
+    glBindTexture(GL_TEXTURE_2D, ismTargets[1]->textureId());
+
+    glViewport(0, 0, ctx.viewport[2], ctx.viewport[3]);
+    accumFbo[0]->bind();
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    ismRenderShader->bind();
+    ismRenderShader->setUniformValue("u_mvpMat", ctx.camera->mvpMat());
+    ismRenderShader->setUniformValue("u_vplPosition", 6);
+    ismRenderShader->setUniformValue("u_vplNormal", 7);
+    ismRenderShader->setUniformValue("u_vplFlux", 8);
+    ismRenderShader->setUniformValue("u_ismMap", 9);
+    ismRenderShader->setUniformValue("u_accumMap", 10);
+    ismRenderShader->setUniformValue("u_ismRows", ismRows);
+    ismRenderShader->setUniformValue("u_ismCols", ISM_COLS);
+    ismRenderShader->setUniformValue("u_maxDepth", maxDepth);
+    ismRenderShader->setUniformValue("u_bias", ismBias);
+    for (int row = 0; row < ismRows; row++) {
+        const int src = row % 2;
+        const int dst = 1 - src;
+        accumFbo[dst]->bind();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        glActiveTexture(GL_TEXTURE10);
+        glBindTexture(GL_TEXTURE_2D, accumTexture[src]->textureId());
+        ismRenderShader->setUniformValue("u_currentRow", row);
+        drawScene(ctx, *ismRenderShader);
+    }
+    ismRenderShader->release();
+    accumFbo[0]->release();
+}
@@ -0,0 +1,52 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _ISM_TECHNIQUE_H_
+#define _ISM_TECHNIQUE_H_
+
+#include <memory>
+
+#include "shadowtechnique.h"
+#include "rsmtechnique.h"
+
+// Imperfect shadow maps: VPLs are sampled from an RSM, each gets a small
+// paraboloid depth map splatted from the point samples, and the indirect
+// light is accumulated in screen space one row of VPLs at a time.
+class IsmTechnique : public ShadowTechnique {
+public:
+    void initialize(const RenderContext &ctx) override;
+    void release() override;
+    void render(const RenderContext &ctx) override;
+
+    inline CullStats cullStats() const override {
+        CullStats stats = rsm.cullStats();
+        stats.cameraClusters = cameraClusters;
+        return stats;
+    }
+
+private:
+    void compileShaders();
+    void createTargets(const RenderContext &ctx);
+    void createVplTargets(const RenderContext &ctx);
+    void createAccumTargets(const RenderContext &ctx);
+    void renderIsm(const RenderContext &ctx);
+
+    RsmTechnique rsm;
+
+    std::unique_ptr<QOpenGLShaderProgram> vplShader = nullptr;
+    std::unique_ptr<QOpenGLShaderProgram> ismShader = nullptr;
+    std::unique_ptr<QOpenGLShaderProgram> ismRenderShader = nullptr;
+    std::unique_ptr<QOpenGLShaderProgram> shader = nullptr;
+    std::unique_ptr<Framebuffer> vplFbo = nullptr;
+    std::unique_ptr<Framebuffer> ismFbo = nullptr;
+    std::unique_ptr<Framebuffer> accumFbo[2];
+    std::vector<std::shared_ptr<RenderTarget>> vplTargets;
+    std::vector<std::shared_ptr<RenderTarget>> ismTargets;
+    std::shared_ptr<RenderTarget> accumTexture[2];
+    std::shared_ptr<RenderTarget> accumDepth;
+    int ismRows = 0;
+    bool deferred = false;
+};
+
+#endif  // _ISM_TECHNIQUE_H_
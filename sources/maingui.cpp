@@ -4,7 +4,15 @@
 #include <QtWidgets/qpushbutton.h>
 #include <QtWidgets/qgroupbox.h>
 #include <QtWidgets/qradiobutton.h>
+#include <QtWidgets/qcheckbox.h>
 #include <QtWidgets/qfiledialog.h>
+#include <QtWidgets/qcombobox.h>
+#include <QtWidgets/qlabel.h>
+#include <QtWidgets/qspinbox.h>
+#include <QtWidgets/qformlayout.h>
+#include <QtWidgets/qmenubar.h>
+#include <QtWidgets/qstatusbar.h>
+#include <QtCore/qdatetime.h>
 
 #include "common.h"
 #include "openglviewer.h"
@@ -24,7 +32,31 @@ public:
         , groupLayout{ new QVBoxLayout }
         , smRadioButton{ new QRadioButton }
         , rsmRadioButton{ new QRadioButton }
-        , ismRadioButton{ new QRadioButton } {        
+        , ismRadioButton{ new QRadioButton }
+        , rsmFormatBox{ new QComboBox }
+        , layoutBox{ new QComboBox }
+        , qualityGroup{ new QGroupBox }
+        , qualityLayout{ new QFormLayout }
+        , shadowSizeBox{ new QSpinBox }
+        , samplesBox{ new QSpinBox }
+        , radiusBox{ new QDoubleSpinBox }
+        , downsampleBox{ new QComboBox }
+        , temporalBox{ new QCheckBox }
+        , hierarchyBox{ new QCheckBox }
+        , vplBox{ new QSpinBox }
+        , vertexLayoutBox{ new QComboBox }
+        , optimizeMeshBox{ new QCheckBox }
+        , clusterCullingBox{ new QCheckBox }
+        , deferredBox{ new QCheckBox }
+        , profileGroup{ new QGroupBox }
+        , profileLayout{ new QVBoxLayout }
+        , timingLabel{ new QLabel }
+        , profileFormatBox{ new QComboBox }
+        , recordButton{ new QPushButton }
+        , dumpGroup{ new QGroupBox }
+        , dumpLayout{ new QVBoxLayout }
+        , dumpFormatBox{ new QComboBox }
+        , dumpButton{ new QPushButton } {        
         setLayout(layout);
         layout->setAlignment(Qt::AlignTop);
 
@@ -39,18 +71,149 @@ public:
         ismRadioButton->setText("ISM");
         groupLayout->addWidget(ismRadioButton);
 
+        // RSM storage format
+        rsmFormatBox->addItem("Compact RSM (12 B/texel)", (int)RsmFormat::Compact);
+        rsmFormatBox->addItem("Full RSM (64 B/texel)", (int)RsmFormat::Full);
+        layout->addWidget(rsmFormatBox);
+
+        // Cube face storage
+        layoutBox->addItem("4x3 atlas", (int)ShadowMapLayout::Atlas);
+        layoutBox->addItem("Layered (gl_Layer)", (int)ShadowMapLayout::Layered);
+        layout->addWidget(layoutBox);
+
+        // Quality / performance trade-offs
+        layout->addWidget(qualityGroup);
+        qualityGroup->setTitle("Quality");
+        qualityGroup->setLayout(qualityLayout);
+        shadowSizeBox->setRange(64, 4096);
+        shadowSizeBox->setSingleStep(64);
+        qualityLayout->addRow("Shadow map size", shadowSizeBox);
+        samplesBox->setRange(1, 1024);
+        qualityLayout->addRow("RSM samples", samplesBox);
+        radiusBox->setRange(0.001, 1.0);
+        radiusBox->setDecimals(3);
+        radiusBox->setSingleStep(0.05);
+        qualityLayout->addRow("RSM radius", radiusBox);
+        downsampleBox->addItem("Full", 1);
+        downsampleBox->addItem("Half", 2);
+        downsampleBox->addItem("Quarter", 4);
+        qualityLayout->addRow("RSM indirect res.", downsampleBox);
+        qualityLayout->addRow("RSM temporal", temporalBox);
+        qualityLayout->addRow("RSM mip hierarchy", hierarchyBox);
+        vplBox->setRange(ISM_COLS, 32 * ISM_COLS);
+        vplBox->setSingleStep(ISM_COLS);
+        qualityLayout->addRow("ISM VPLs", vplBox);
+        vertexLayoutBox->addItem("Float (28 B)", (int)VertexLayout::Float);
+        vertexLayoutBox->addItem("Quantized (16 B)", (int)VertexLayout::Quantized);
+        qualityLayout->addRow("Vertex format", vertexLayoutBox);
+        qualityLayout->addRow("Optimize mesh", optimizeMeshBox);
+        qualityLayout->addRow("Cluster culling", clusterCullingBox);
+        qualityLayout->addRow("Deferred shading", deferredBox);
+
+        // Per-pass frame timings
+        layout->addWidget(profileGroup);
+        profileGroup->setTitle("Profiler");
+        profileGroup->setLayout(profileLayout);
+        timingLabel->setText("Frame: -");
+        profileLayout->addWidget(timingLabel);
+        profileFormatBox->addItem("CSV", "csv");
+        profileFormatBox->addItem("JSON", "json");
+        profileLayout->addWidget(profileFormatBox);
+        recordButton->setText("Record");
+        recordButton->setCheckable(true);
+        profileLayout->addWidget(recordButton);
+
+        // Shadow map dump (debug)
+        layout->addWidget(dumpGroup);
+        dumpGroup->setTitle("Shadow map dump");
+        dumpGroup->setLayout(dumpLayout);
+        dumpFormatBox->addItem("PNG", (int)DumpFormat::PNG);
+        dumpFormatBox->addItem("PFM (float)", (int)DumpFormat::PFM);
+        dumpFormatBox->addItem("EXR (float)", (int)DumpFormat::EXR);
+        dumpLayout->addWidget(dumpFormatBox);
+        dumpButton->setText("Dump");
+        dumpLayout->addWidget(dumpButton);
+
         // Save button
         saveButton->setText("Save");
         layout->addWidget(saveButton);
     }
 
     virtual ~Ui() {
+        delete deferredBox;
+        delete clusterCullingBox;
+        delete optimizeMeshBox;
+        delete vertexLayoutBox;
+        delete vplBox;
+        delete temporalBox;
+        delete hierarchyBox;
+        delete downsampleBox;
+        delete radiusBox;
+        delete samplesBox;
+        delete shadowSizeBox;
+        delete qualityLayout;
+        delete qualityGroup;
+        delete recordButton;
+        delete profileFormatBox;
+        delete timingLabel;
+        delete profileLayout;
+        delete profileGroup;
+        delete rsmFormatBox;
+        delete layoutBox;
+        delete dumpButton;
+        delete dumpFormatBox;
+        delete dumpLayout;
+        delete dumpGroup;
         delete groupLayout;
         delete smTypeGroup;
         delete saveButton;
         delete layout;
     }
 
+    void setSettings(const RenderSettings &settings) {
+        smRadioButton->setChecked(settings.mode == ShadowMapType::SM);
+        rsmRadioButton->setChecked(settings.mode == ShadowMapType::RSM);
+        ismRadioButton->setChecked(settings.mode == ShadowMapType::ISM);
+        rsmFormatBox->setCurrentIndex(rsmFormatBox->findData((int)settings.rsmFormat));
+        layoutBox->setCurrentIndex(layoutBox->findData((int)settings.layout));
+        shadowSizeBox->setValue(settings.shadowMapSize);
+        samplesBox->setValue(settings.nSamples);
+        radiusBox->setValue(settings.sampleRadius);
+        downsampleBox->setCurrentIndex(downsampleBox->findData(settings.indirectDownsample));
+        temporalBox->setChecked(settings.temporal);
+        hierarchyBox->setChecked(settings.rsmHierarchy);
+        vplBox->setValue(settings.vplCount);
+        vertexLayoutBox->setCurrentIndex(vertexLayoutBox->findData((int)settings.vertexLayout));
+        optimizeMeshBox->setChecked(settings.optimizeMesh);
+        clusterCullingBox->setChecked(settings.clusterCulling);
+        deferredBox->setChecked(settings.deferred);
+    }
+
+    RenderSettings settings() const {
+        RenderSettings settings;
+        if (rsmRadioButton->isChecked()) {
+            settings.mode = ShadowMapType::RSM;
+        } else if (ismRadioButton->isChecked()) {
+            settings.mode = ShadowMapType::ISM;
+        } else {
+            settings.mode = ShadowMapType::SM;
+        }
+        settings.rsmFormat = (RsmFormat)rsmFormatBox->currentData().toInt();
+        settings.layout = (ShadowMapLayout)layoutBox->currentData().toInt();
+        settings.shadowMapSize = shadowSizeBox->value();
+        settings.nSamples = samplesBox->value();
+        settings.sampleRadius = (float)radiusBox->value();
+        settings.indirectDownsample = downsampleBox->currentData().toInt();
+        settings.temporal = temporalBox->isChecked();
+        settings.rsmHierarchy = hierarchyBox->isChecked();
+        settings.vplCount = vplBox->value();
+        settings.vertexLayout = (VertexLayout)vertexLayoutBox->currentData().toInt();
+        settings.optimizeMesh = optimizeMeshBox->isChecked();
+        settings.clusterCulling = clusterCullingBox->isChecked();
+        settings.deferred = deferredBox->isChecked();
+        return settings;
+    }
+
     // Public fields
     QVBoxLayout* layout;
     QPushButton* saveButton;
@@ -60,6 +223,33 @@ public:
     QRadioButton* smRadioButton;
     QRadioButton* rsmRadioButton;
     QRadioButton* ismRadioButton;
+
+    QComboBox* rsmFormatBox;
+    QComboBox* layoutBox;
+
+    QGroupBox* qualityGroup;
+    QFormLayout* qualityLayout;
+    QSpinBox* shadowSizeBox;
+    QSpinBox* samplesBox;
+    QDoubleSpinBox* radiusBox;
+    QComboBox* downsampleBox;
+    QCheckBox* temporalBox;
+    QCheckBox* hierarchyBox;
+    QSpinBox* vplBox;
+    QComboBox* vertexLayoutBox;
+    QCheckBox* optimizeMeshBox;
+    QCheckBox* clusterCullingBox;
+    QCheckBox* deferredBox;
+    QGroupBox* profileGroup;
+    QVBoxLayout* profileLayout;
+    QLabel* timingLabel;
+    QComboBox* profileFormatBox;
+    QPushButton* recordButton;
+
+    QGroupBox* dumpGroup;
+    QVBoxLayout* dumpLayout;
+    QComboBox* dumpFormatBox;
+    QPushButton* dumpButton;
 };
 
 
@@ -67,10 +257,11 @@ public:
 // MainGUI method definitions
 // --
 
-MainGUI::MainGUI(QWidget* parent) 
+MainGUI::MainGUI(const RenderSettings &settings, QWidget* parent) 
     : QMainWindow{ parent }
     , mainWidget{ new QWidget }
     , mainLayout{ new QGridLayout }
+    , loadingBar{ new QProgressBar }
     , viewer{ nullptr }
     , ui{ nullptr } {
     mainWidget->setLayout(mainLayout);
@@ -85,20 +276,74 @@ MainGUI::MainGUI(QWidget* parent)
     mainLayout->addWidget(viewer, 0, 0);
     mainLayout->addWidget(ui, 0, 1);
 
+    // Scene loading runs in the background; the bar shows while it does
+    menuBar()->addMenu(tr("&File"))->addAction(tr("&Open..."), this, SLOT(OnOpenTriggered()),
+                                               QKeySequence::Open);
+    loadingBar->setRange(0, 100);
+    loadingBar->setFormat(tr("Loading %p%"));
+    loadingBar->setMaximumWidth(240);
+    loadingBar->setVisible(false);
+    statusBar()->addPermanentWidget(loadingBar);
+
+    viewer->setSettings(settings);
+    ui->setSettings(viewer->settings());
+
     // Connect SIGNAL/SLOT
     connect(ui->saveButton, SIGNAL(clicked()), this, SLOT(OnSaveButtonClicked()));
-    connect(ui->smRadioButton, SIGNAL(toggled(bool)), this, SLOT(OnRadioButtonChanged(bool)));
-    connect(ui->rsmRadioButton, SIGNAL(toggled(bool)), this, SLOT(OnRadioButtonChanged(bool)));
-    connect(ui->ismRadioButton, SIGNAL(toggled(bool)), this, SLOT(OnRadioButtonChanged(bool)));
+    connect(ui->smRadioButton, SIGNAL(toggled(bool)), this, SLOT(OnSettingsChanged()));
+    connect(ui->rsmRadioButton, SIGNAL(toggled(bool)), this, SLOT(OnSettingsChanged()));
+    connect(ui->ismRadioButton, SIGNAL(toggled(bool)), this, SLOT(OnSettingsChanged()));
+    connect(ui->dumpButton, SIGNAL(clicked()), this, SLOT(OnDumpButtonClicked()));
+    connect(ui->recordButton, SIGNAL(toggled(bool)), this, SLOT(OnRecordButtonToggled(bool)));
+    connect(ui->rsmFormatBox, SIGNAL(currentIndexChanged(int)), this, SLOT(OnSettingsChanged()));
+    connect(ui->layoutBox, SIGNAL(currentIndexChanged(int)), this, SLOT(OnSettingsChanged()));
+    connect(ui->shadowSizeBox, SIGNAL(valueChanged(int)), this, SLOT(OnSettingsChanged()));
+    connect(ui->samplesBox, SIGNAL(valueChanged(int)), this, SLOT(OnSettingsChanged()));
+    connect(ui->radiusBox, SIGNAL(valueChanged(double)), this, SLOT(OnSettingsChanged()));
+    connect(ui->downsampleBox, SIGNAL(currentIndexChanged(int)), this, SLOT(OnSettingsChanged()));
+    connect(ui->temporalBox, SIGNAL(toggled(bool)), this, SLOT(OnSettingsChanged()));
+    connect(ui->hierarchyBox, SIGNAL(toggled(bool)), this, SLOT(OnSettingsChanged()));
+    connect(ui->vplBox, SIGNAL(valueChanged(int)), this, SLOT(OnSettingsChanged()));
+    connect(ui->vertexLayoutBox, SIGNAL(currentIndexChanged(int)), this, SLOT(OnSettingsChanged()));
+    connect(ui->optimizeMeshBox, SIGNAL(toggled(bool)), this, SLOT(OnSettingsChanged()));
+    connect(ui->clusterCullingBox, SIGNAL(toggled(bool)), this, SLOT(OnSettingsChanged()));
+    connect(ui->deferredBox, SIGNAL(toggled(bool)), this, SLOT(OnSettingsChanged()));
+    connect(viewer, SIGNAL(timingsChanged(QString)), ui->timingLabel, SLOT(setText(QString)));
+    connect(viewer, SIGNAL(loadingProgress(int)), this, SLOT(OnLoadingProgress(int)));
+    connect(viewer, SIGNAL(shadowMapSizeLimit(int)), this, SLOT(OnShadowMapSizeLimit(int)));
 }
 
 MainGUI::~MainGUI() {
     delete viewer;
     delete ui;
     delete mainLayout;
+    delete loadingBar;
     delete mainWidget;
 }
 
+void MainGUI::OnOpenTriggered() {
+    const QString filename =
+        QFileDialog::getOpenFileName(this, tr("Open"), tr(DATA_DIRECTORY),
+                                     tr("Scenes (*.txt *.scene *.ply);;All files (*)"));
+    if (filename == "") return;
+
+    // The viewer starts the load on its next frame
+    RenderSettings settings = viewer->settings();
+    settings.scene = filename;
+    viewer->setSettings(settings);
+}
+
+void MainGUI::OnLoadingProgress(int percent) {
+    loadingBar->setValue(percent);
+    loadingBar->setVisible(percent < 100);
+}
+
+// Lowering the maximum clamps the value, which reaches the viewer
+// through OnSettingsChanged()
+void MainGUI::OnShadowMapSizeLimit(int maxSize) {
+    ui->shadowSizeBox->setMaximum(maxSize);
+}
+
 void MainGUI::OnSaveButtonClicked() {
     QString savefile = 
         QFileDialog::getSaveFileName(this, tr("Save"), 
@@ -110,12 +355,28 @@ void MainGUI::OnSaveButtonClicked() {
     image.save(savefile);
 }
 
-void MainGUI::OnRadioButtonChanged(bool) {
-    if (ui->smRadioButton->isChecked()) {
-        viewer->setShadowMode(ShadowMapType::SM);
-    } else if (ui->rsmRadioButton->isChecked()) {
-        viewer->setShadowMode(ShadowMapType::RSM);
-    } else if (ui->ismRadioButton->isChecked()) {
-        viewer->setShadowMode(ShadowMapType::ISM);
+void MainGUI::OnSettingsChanged() {
+    // The scene is not edited in the panel
+    RenderSettings settings = ui->settings();
+    settings.scene = viewer->settings().scene;
+    viewer->setSettings(settings);
+}
+
+void MainGUI::OnDumpButtonClicked() {
+    const DumpFormat format = (DumpFormat)ui->dumpFormatBox->currentData().toInt();
+    viewer->requestShadowMapDump(format);
+}
+
+void MainGUI::OnRecordButtonToggled(bool checked) {
+    if (checked) {
+        ui->recordButton->setText("Stop");
+        viewer->startProfileRecording();
+        return;
     }
+
+    const QString filename = QString(OUTPUT_DIRECTORY) + "profile_" +
+        QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss") + "." +
+        ui->profileFormatBox->currentData().toString();
+    viewer->stopProfileRecording(filename);
+    ui->recordButton->setText("Record");
 }
@@ -8,6 +8,7 @@
 #include <QtWidgets/qmainwindow.h>
 #include <QtWidgets/qgridlayout.h>
 #include <QtWidgets/qopenglwidget.h>
+#include <QtWidgets/qprogressbar.h>
 
 #include "openglviewer.h"
 
@@ -15,18 +16,24 @@ class MainGUI : public QMainWindow {
     Q_OBJECT
 public:
     // Public methods
-    explicit MainGUI(QWidget* parent = nullptr);
+    explicit MainGUI(const RenderSettings &settings = RenderSettings(), QWidget* parent = nullptr);
     ~MainGUI();
 
 private slots:
     // Private slots
+    void OnOpenTriggered();
+    void OnLoadingProgress(int percent);
+    void OnShadowMapSizeLimit(int maxSize);
     void OnSaveButtonClicked();
-    void OnRadioButtonChanged(bool);
+    void OnSettingsChanged();
+    void OnDumpButtonClicked();
+    void OnRecordButtonToggled(bool);
 
 private:
     // Private fields
     QWidget *mainWidget;
     QGridLayout *mainLayout;
+    QProgressBar *loadingBar;
 
     OpenGLViewer *viewer;
 
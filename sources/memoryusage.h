@@ -0,0 +1,13 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _MEMORY_USAGE_H_
+#define _MEMORY_USAGE_H_
+
+#include <cstddef>
+
+// Peak resident set size of this process in bytes, 0 if unavailable
+size_t peakResidentBytes();
+
+#endif  // _MEMORY_USAGE_H_
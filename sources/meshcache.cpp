@@ -0,0 +1,198 @@
+#include "meshcache.h"
+
+#include <cstring>
+#include <iostream>
+
+#include <QtCore/qfileinfo.h>
+#include <QtCore/qdatetime.h>
+#include <QtCore/qsavefile.h>
+
+namespace {
+
+const char MAGIC[8] = { 'M', 'E', 'S', 'H', 'C', 'A', 'C', 'H' };
+const uint32_t VERSION = 2;
+
+// Blobs start on 16-byte boundaries
+uint64_t align16(uint64_t offset) {
+    return (offset + 15) & ~(uint64_t)15;
+}
+
+bool writePadding(QSaveFile &file, uint64_t &offset) {
+    static const char zeros[16] = { 0 };
+    const uint64_t aligned = align16(offset);
+    if (file.write(zeros, (qint64)(aligned - offset)) != (qint64)(aligned - offset)) return false;
+    offset = aligned;
+    return true;
+}
+
+}  // anonymous namespace
+
+MeshCache::MeshCache(const std::string &source)
+    : source_(source)
+    , path_(source + ".meshcache") {
+}
+
+MeshCache::~MeshCache() {
+    close();
+}
+
+bool MeshCache::sourceKey(std::string *path, uint64_t *size, int64_t *time) const {
+    QFileInfo info(QString::fromStdString(source_));
+    if (!info.exists()) return false;
+
+    *path = info.canonicalFilePath().toStdString();
+    *size = (uint64_t)info.size();
+    *time = info.lastModified().toMSecsSinceEpoch();
+    return true;
+}
+
+bool MeshCache::open() {
+    close();
+
+    std::string path;
+    uint64_t size;
+    int64_t time;
+    if (!sourceKey(&path, &size, &time)) return false;
+
+    file_.setFileName(QString::fromStdString(path_));
+    if (!file_.open(QIODevice::ReadOnly)) return false;
+
+    const uint64_t fileBytes = (uint64_t)file_.size();
+    if (fileBytes < sizeof(MeshCacheHeader)) {
+        close();
+        return false;
+    }
+
+    data_ = file_.map(0, file_.size());
+    if (!data_) {
+        close();
+        return false;
+    }
+
+    const MeshCacheHeader *h = (const MeshCacheHeader *)data_;
+    const bool valid =
+        std::memcmp(h->magic, MAGIC, sizeof(MAGIC)) == 0 &&
+        h->version == VERSION &&
+        h->fileBytes == fileBytes &&
+        h->attributeCount <= MeshCacheHeader::MAX_ATTRIBUTES &&
+        h->pathOffset + h->pathBytes <= fileBytes &&
+        h->vertexOffset + (uint64_t)h->vertexCount * h->vertexStride <= fileBytes &&
+        h->indexOffset + (uint64_t)h->indexCount * sizeof(uint32_t) <= fileBytes &&
+        h->pointOffset + (uint64_t)h->pointCount * 3 * sizeof(float) <= fileBytes;
+    if (!valid) {
+        close();
+        return false;
+    }
+
+    const std::string cachedPath((const char *)data_ + h->pathOffset, h->pathBytes);
+    if (cachedPath != path || h->sourceSize != size || h->sourceTime != time) {
+        close();
+        return false;
+    }
+
+    header_ = h;
+    return true;
+}
+
+void MeshCache::close() {
+    if (data_) {
+        file_.unmap((uchar *)data_);
+        data_ = nullptr;
+    }
+    header_ = nullptr;
+    file_.close();
+}
+
+VertexFormat MeshCache::format() const {
+    VertexFormat format;
+    format.stride = header_->vertexStride;
+    format.attributes.assign(header_->attributes, header_->attributes + header_->attributeCount);
+    format.positionOffset = QVector3D(header_->positionOffset[0], header_->positionOffset[1], header_->positionOffset[2]);
+    format.positionScale = QVector3D(header_->positionScale[0], header_->positionScale[1], header_->positionScale[2]);
+    return format;
+}
+
+bool MeshCache::write(VertexLayout layout, uint32_t flags, const VertexFormat &format,
+                      const uint8_t *vertices, uint32_t vertexCount,
+                      const uint8_t *triangles, size_t triangleStride, uint32_t indexCount,
+                      const float *points, uint32_t pointCount, const QVector3D &bboxMin, const QVector3D &bboxMax) {
+    close();
+
+    std::string path;
+    MeshCacheHeader h;
+    std::memset(&h, 0, sizeof(h));
+    if (!sourceKey(&path, &h.sourceSize, &h.sourceTime)) return false;
+    if (format.attributes.size() > MeshCacheHeader::MAX_ATTRIBUTES) return false;
+
+    std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = VERSION;
+    h.attributeCount = (uint32_t)format.attributes.size();
+    std::copy(format.attributes.begin(), format.attributes.end(), h.attributes);
+    for (int k = 0; k < 3; k++) {
+        h.bboxMin[k] = bboxMin[k];
+        h.bboxMax[k] = bboxMax[k];
+        h.positionOffset[k] = format.positionOffset[k];
+        h.positionScale[k] = format.positionScale[k];
+    }
+    h.vertexLayout = (uint32_t)layout;
+    h.flags = flags;
+    h.vertexCount = vertexCount;
+    h.vertexStride = format.stride;
+    h.indexCount = indexCount;
+    h.pointCount = pointCount;
+
+    const uint64_t vertexBytes = (uint64_t)vertexCount * format.stride;
+    const uint64_t indexBytes = (uint64_t)indexCount * sizeof(uint32_t);
+    h.pathOffset = sizeof(MeshCacheHeader);
+    h.pathBytes = path.size();
+    h.vertexOffset = align16(h.pathOffset + h.pathBytes);
+    h.indexOffset = align16(h.vertexOffset + vertexBytes);
+    h.pointOffset = align16(h.indexOffset + indexBytes);
+    h.fileBytes = h.pointOffset + (uint64_t)pointCount * 3 * sizeof(float);
+
+    QSaveFile file(QString::fromStdString(path_));
+    if (!file.open(QIODevice::WriteOnly)) {
+        std::cerr << "[ERROR] failed to write mesh cache: " << path_ << std::endl;
+        return false;
+    }
+
+    uint64_t offset = 0;
+    bool ok = file.write((const char *)&h, sizeof(h)) == (qint64)sizeof(h);
+    ok = ok && file.write(path.data(), (qint64)path.size()) == (qint64)path.size();
+    offset = h.pathOffset + h.pathBytes;
+    ok = ok && writePadding(file, offset);
+    ok = ok && file.write((const char *)vertices, (qint64)vertexBytes) == (qint64)vertexBytes;
+    offset += vertexBytes;
+    ok = ok && writePadding(file, offset);
+
+    // Triangles may be strided records of the source file
+    const size_t TRIANGLE_BATCH = 65536;
+    std::vector<uint8_t> batch;
+    const uint32_t nTris = indexCount / 3;
+    for (uint32_t t = 0; ok && t < nTris; t += TRIANGLE_BATCH) {
+        const uint32_t n = std::min((uint32_t)TRIANGLE_BATCH, nTris - t);
+        const size_t bytes = n * 3 * sizeof(uint32_t);
+        if (triangleStride == 3 * sizeof(uint32_t)) {
+            ok = file.write((const char *)(triangles + t * triangleStride), (qint64)bytes) == (qint64)bytes;
+            continue;
+        }
+
+        batch.resize(bytes);
+        for (uint32_t i = 0; i < n; i++) {
+            std::memcpy(&batch[i * 3 * sizeof(uint32_t)], triangles + (size_t)(t + i) * triangleStride,
+                        3 * sizeof(uint32_t));
+        }
+        ok = file.write((const char *)batch.data(), (qint64)bytes) == (qint64)bytes;
+    }
+    offset += indexBytes;
+    ok = ok && writePadding(file, offset);
+
+    const qint64 pointBytes = (qint64)pointCount * 3 * sizeof(float);
+    ok = ok && file.write((const char *)points, pointBytes) == pointBytes;
+
+    if (!ok || !file.commit()) {
+        std::cerr << "[ERROR] failed to write mesh cache: " << path_ << std::endl;
+        return false;
+    }
+    return true;
+}
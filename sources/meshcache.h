@@ -0,0 +1,86 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _MESH_CACHE_H_
+#define _MESH_CACHE_H_
+
+#include <string>
+#include <vector>
+
+#include <QtCore/qfile.h>
+#include <QtGui/qvector3d.h>
+
+#include "vertexformat.h"
+
+struct MeshCacheHeader {
+    static const int MAX_ATTRIBUTES = 8;
+
+    // Triangles and vertices are in optimized order (see meshoptimizer.h)
+    static const uint32_t FLAG_OPTIMIZED = 0x01;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t attributeCount;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    float bboxMin[3];
+    float bboxMax[3];
+    uint32_t vertexCount;
+    uint32_t vertexStride;
+    uint32_t indexCount;
+    uint32_t pointCount;
+    uint32_t vertexLayout;
+    float positionOffset[3];
+    float positionScale[3];
+    uint32_t flags;
+    VertexAttribute attributes[MAX_ATTRIBUTES];
+    uint64_t pathOffset;
+    uint64_t pathBytes;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t pointOffset;
+    uint64_t fileBytes;
+};
+
+// Compact binary copy of a loaded mesh, stored next to its source as
+// <source>.meshcache. It holds the interleaved vertex records, 32-bit
+// triangle indices, ISM point samples and bounds, so a warm start uploads
+// straight from the mapped cache without parsing the PLY file. A cache is
+// only used for the source path, size and modification time it was
+// written from.
+class MeshCache {
+public:
+    explicit MeshCache(const std::string &source);
+    virtual ~MeshCache();
+
+    // Maps the cache; false if it is missing, stale or malformed
+    bool open();
+    void close();
+
+    bool write(VertexLayout layout, uint32_t flags, const VertexFormat &format,
+               const uint8_t *vertices, uint32_t vertexCount,
+               const uint8_t *triangles, size_t triangleStride, uint32_t indexCount,
+               const float *points, uint32_t pointCount, const QVector3D &bboxMin, const QVector3D &bboxMax);
+
+    inline const MeshCacheHeader &header() const { return *header_; }
+    inline VertexLayout layout() const { return (VertexLayout)header_->vertexLayout; }
+    inline bool isOptimized() const { return (header_->flags & MeshCacheHeader::FLAG_OPTIMIZED) != 0; }
+    VertexFormat format() const;
+    inline const uint8_t *vertices() const { return data_ + header_->vertexOffset; }
+    inline const uint8_t *indices() const { return data_ + header_->indexOffset; }
+    inline const float *points() const { return (const float *)(data_ + header_->pointOffset); }
+
+    inline const std::string &path() const { return path_; }
+
+private:
+    bool sourceKey(std::string *path, uint64_t *size, int64_t *time) const;
+
+    std::string source_;
+    std::string path_;
+    QFile file_;
+    const uint8_t *data_ = nullptr;
+    const MeshCacheHeader *header_ = nullptr;
+};
+
+#endif  // _MESH_CACHE_H_
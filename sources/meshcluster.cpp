@@ -0,0 +1,181 @@
+#include "meshcluster.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+
+namespace {
+
+const uint32_t SHORT_INDEX_RANGE = 0xFFFF;
+
+inline void readTriangle(const uint8_t *triangles, size_t triangleStride, size_t t, uint32_t idx[3]) {
+    std::memcpy(idx, triangles + t * triangleStride, 3 * sizeof(uint32_t));
+}
+
+inline QVector3D readPosition(const float *positions, uint32_t v) {
+    return QVector3D(positions[v * 3 + 0], positions[v * 3 + 1], positions[v * 3 + 2]);
+}
+
+// Box-centered sphere and normal cone of triangles [begin, end)
+void computeBounds(MeshCluster &cluster, const uint8_t *triangles, size_t triangleStride,
+                   size_t begin, size_t end, const float *positions) {
+    QVector3D lo( std::numeric_limits<float>::max(),  std::numeric_limits<float>::max(),  std::numeric_limits<float>::max());
+    QVector3D hi(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max());
+    QVector3D normalSum(0.0f, 0.0f, 0.0f);
+    uint32_t idx[3];
+    for (size_t t = begin; t < end; t++) {
+        readTriangle(triangles, triangleStride, t, idx);
+        const QVector3D p0 = readPosition(positions, idx[0]);
+        const QVector3D p1 = readPosition(positions, idx[1]);
+        const QVector3D p2 = readPosition(positions, idx[2]);
+        for (int k = 0; k < 3; k++) {
+            lo[k] = std::min(std::min(lo[k], p0[k]), std::min(p1[k], p2[k]));
+            hi[k] = std::max(std::max(hi[k], p0[k]), std::max(p1[k], p2[k]));
+        }
+        normalSum += QVector3D::crossProduct(p1 - p0, p2 - p0).normalized();
+    }
+
+    cluster.center = 0.5f * (lo + hi);
+    float radius2 = 0.0f;
+    for (size_t t = begin; t < end; t++) {
+        readTriangle(triangles, triangleStride, t, idx);
+        for (int k = 0; k < 3; k++) {
+            radius2 = std::max(radius2, (readPosition(positions, idx[k]) - cluster.center).lengthSquared());
+        }
+    }
+    cluster.radius = std::sqrt(radius2);
+
+    // The cone spans the widest angle between the mean and a face normal
+    cluster.coneAxis = normalSum.normalized();
+    cluster.coneCutoff = 1.0f;
+    if (normalSum.lengthSquared() <= 0.0f) return;
+
+    float minDot = 1.0f;
+    for (size_t t = begin; t < end; t++) {
+        readTriangle(triangles, triangleStride, t, idx);
+        const QVector3D p0 = readPosition(positions, idx[0]);
+        const QVector3D n = QVector3D::crossProduct(readPosition(positions, idx[1]) - p0,
+                                                    readPosition(positions, idx[2]) - p0);
+        if (n.lengthSquared() <= 0.0f) continue;
+        minDot = std::min(minDot, QVector3D::dotProduct(n.normalized(), cluster.coneAxis));
+    }
+    if (minDot > 0.0f) {
+        cluster.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+    }
+}
+
+}  // anonymous namespace
+
+bool fitsShortIndices(const uint8_t *triangles, size_t triangleStride, size_t indexCount) {
+    uint32_t idx[3];
+    for (size_t t = 0; t < indexCount / 3; t++) {
+        readTriangle(triangles, triangleStride, t, idx);
+        const uint32_t lo = std::min(idx[0], std::min(idx[1], idx[2]));
+        const uint32_t hi = std::max(idx[0], std::max(idx[1], idx[2]));
+        if (hi - lo > SHORT_INDEX_RANGE) return false;
+    }
+    return true;
+}
+
+std::vector<MeshCluster> buildClusters(const uint8_t *triangles, size_t triangleStride, size_t indexCount,
+                                       const float *positions, bool shortIndices, void *dest) {
+    std::vector<MeshCluster> clusters;
+    const size_t triCount = indexCount / 3;
+    uint32_t idx[3];
+
+    size_t t = 0;
+    while (t < triCount) {
+        // Grow the run while its vertex range still fits 16 bits
+        const size_t begin = t;
+        uint32_t lo = std::numeric_limits<uint32_t>::max();
+        uint32_t hi = 0;
+        for (; t < triCount && t - begin < (size_t)MAX_CLUSTER_TRIANGLES; t++) {
+            readTriangle(triangles, triangleStride, t, idx);
+            const uint32_t triLo = std::min(lo, std::min(idx[0], std::min(idx[1], idx[2])));
+            const uint32_t triHi = std::max(hi, std::max(idx[0], std::max(idx[1], idx[2])));
+            if (shortIndices && triHi - triLo > SHORT_INDEX_RANGE) break;
+            lo = triLo;
+            hi = triHi;
+        }
+
+        MeshCluster cluster;
+        cluster.firstIndex = (uint32_t)(begin * 3);
+        cluster.indexCount = (uint32_t)((t - begin) * 3);
+        cluster.baseVertex = shortIndices ? (int32_t)lo : 0;
+        cluster.vertexEnd = hi + 1;
+        computeBounds(cluster, triangles, triangleStride, begin, t, positions);
+        clusters.push_back(cluster);
+
+        for (size_t i = begin; i < t; i++) {
+            readTriangle(triangles, triangleStride, i, idx);
+            for (int k = 0; k < 3; k++) {
+                const uint32_t local = idx[k] - (uint32_t)cluster.baseVertex;
+                if (shortIndices) {
+                    ((uint16_t *)dest)[i * 3 + k] = (uint16_t)local;
+                } else {
+                    ((uint32_t *)dest)[i * 3 + k] = local;
+                }
+            }
+        }
+    }
+    return clusters;
+}
+
+ClusterCuller ClusterCuller::frustum(const QMatrix4x4 &mvpMat, const QVector3D &eye) {
+    ClusterCuller culler;
+    culler.eye_ = eye;
+    culler.maxDistance_ = std::numeric_limits<float>::max();
+
+    // Clip planes from the rows of the matrix, normalized so that plane
+    // distances are in world units
+    for (int axis = 0; axis < 3; axis++) {
+        for (float sign : { 1.0f, -1.0f }) {
+            QVector4D plane = mvpMat.row(3) + sign * mvpMat.row(axis);
+            plane /= plane.toVector3D().length();
+            culler.planes_.push_back(plane);
+        }
+    }
+    return culler;
+}
+
+ClusterCuller ClusterCuller::lightCube(const QVector3D &position, float nearPlane, float farPlane) {
+    // Anything closer than the near plane is clipped in every face
+    ClusterCuller culler;
+    culler.eye_ = position;
+    culler.minDistance_ = nearPlane;
+    culler.maxDistance_ = farPlane * std::sqrt(3.0f);
+    return culler;
+}
+
+ClusterCuller ClusterCuller::transformed(const QMatrix4x4 &modelMat) const {
+    const float scale = modelMat.column(0).toVector3D().length();
+
+    ClusterCuller culler;
+    culler.eye_ = modelMat.inverted().map(eye_);
+    culler.minDistance_ = minDistance_ / scale;
+    culler.maxDistance_ = maxDistance_ / scale;
+    for (const auto &plane : planes_) {
+        QVector4D p = plane * modelMat;
+        p /= p.toVector3D().length();
+        culler.planes_.push_back(p);
+    }
+    return culler;
+}
+
+bool ClusterCuller::isVisible(const MeshCluster &cluster) const {
+    for (const auto &plane : planes_) {
+        if (QVector3D::dotProduct(plane.toVector3D(), cluster.center) + plane.w() < -cluster.radius) {
+            return false;
+        }
+    }
+
+    const QVector3D toCenter = cluster.center - eye_;
+    const float distance = toCenter.length();
+    if (distance - cluster.radius > maxDistance_ || distance + cluster.radius < minDistance_) {
+        return false;
+    }
+
+    // Back-facing from every point of the bounding sphere
+    return QVector3D::dotProduct(toCenter, cluster.coneAxis) < cluster.coneCutoff * distance + cluster.radius;
+}
@@ -0,0 +1,70 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _MESH_CLUSTER_H_
+#define _MESH_CLUSTER_H_
+
+#include <cstdint>
+#include <vector>
+
+#include <QtGui/qvector3d.h>
+#include <QtGui/qvector4d.h>
+#include <QtGui/qmatrix4x4.h>
+
+// Triangles per cluster; small enough for culling to pay off, large
+// enough to keep the number of draws low
+static const int MAX_CLUSTER_TRIANGLES = 1024;
+
+// A run of consecutive triangles of the index buffer whose vertices lie
+// within 64K of baseVertex, so its indices fit 16 bits. The bounds are
+// used to cull whole clusters.
+struct MeshCluster {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    int32_t baseVertex;
+    uint32_t vertexEnd;  // one past the highest vertex referenced
+
+    QVector3D center;
+    float radius;
+
+    // Normals lie within a cone around coneAxis; coneCutoff is the sine of
+    // its half angle, 1 if the cluster can face any direction
+    QVector3D coneAxis;
+    float coneCutoff;
+};
+
+// True if every triangle's vertices lie within 64K of each other, so the
+// clusters can use 16-bit indices
+bool fitsShortIndices(const uint8_t *triangles, size_t triangleStride, size_t indexCount);
+
+// Splits the triangles into clusters and writes their indices, relative to
+// each baseVertex, as uint16 or uint32 to dest. Positions are float3.
+std::vector<MeshCluster> buildClusters(const uint8_t *triangles, size_t triangleStride, size_t indexCount,
+                                       const float *positions, bool shortIndices, void *dest);
+
+// Conservative visibility of clusters for one view: bounding spheres
+// against the view volume and normal cones against the view position.
+class ClusterCuller {
+public:
+    // Camera frustum of a model-view-projection matrix; eye is the camera
+    // position in model space
+    static ClusterCuller frustum(const QMatrix4x4 &mvpMat, const QVector3D &eye);
+
+    // Cube map around a point light: the shell between near and far plane
+    static ClusterCuller lightCube(const QVector3D &position, float nearPlane, float farPlane);
+
+    // The same view seen from the model space of an instance. Instances
+    // are rigid transforms with a uniform scale.
+    ClusterCuller transformed(const QMatrix4x4 &modelMat) const;
+
+    bool isVisible(const MeshCluster &cluster) const;
+
+private:
+    QVector3D eye_;
+    std::vector<QVector4D> planes_;
+    float minDistance_ = 0.0f;
+    float maxDistance_ = 0.0f;
+};
+
+#endif  // _MESH_CLUSTER_H_
@@ -0,0 +1,468 @@
+#include "meshloader.h"
+
+#include <cmath>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <random>
+#include <algorithm>
+#include <limits>
+
+#include <QtCore/qfile.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qsysinfo.h>
+
+#include "tinyply.h"
+#include "memoryusage.h"
+#include "meshcache.h"
+#include "meshoptimizer.h"
+
+namespace {
+
+// Vertex and index counts are ints, as are the GL draw counts
+bool fitsCount(uint64_t count) {
+    return count <= (uint64_t)std::numeric_limits<int>::max();
+}
+
+}  // anonymous namespace
+
+MeshLoader::MeshLoader(VertexLayout layout, bool optimize, MeshOwnership ownership)
+    : layout_(layout)
+    , optimize_(optimize)
+    , ownership_(ownership) {
+}
+
+bool MeshLoader::load(const std::string &filename, PreparedMesh *mesh) {
+    QElapsedTimer timer;
+    timer.start();
+
+    *mesh = PreparedMesh();
+    mesh->filename = filename;
+    mesh->layout = layout_;
+    mesh_ = mesh;
+
+    mesh->source = "cached";
+    if (!loadCached(filename)) {
+        mesh->source = "mapped";
+        if (!loadMapped(filename)) {
+            mesh->source = "parsed";
+            if (!loadParsed(filename)) {
+                mesh_ = nullptr;
+                return false;
+            }
+        }
+    }
+    mesh_ = nullptr;
+
+    std::cout << "[ INFO ] Loaded " << filename << " (" << mesh->source << "): "
+              << mesh->vertexCount << " vertices, " << mesh->indexCount / 3 << " triangles in "
+              << timer.elapsed() << " ms, peak RSS "
+              << peakResidentBytes() / (1024 * 1024) << " MB" << std::endl;
+    return true;
+}
+
+// Binary little-endian files whose vertex records can be used as they
+// are: with the float layout the records are uploaded straight from the
+// mapping, otherwise they are encoded from it. Returns false for any file
+// layout it does not handle.
+bool MeshLoader::loadMapped(const std::string &filename) {
+    using tinyply::PlyProperty;
+
+    if (QSysInfo::ByteOrder != QSysInfo::LittleEndian) return false;
+
+    auto file = std::make_shared<QFile>(QString::fromStdString(filename));
+    if (!file->open(QIODevice::ReadOnly)) return false;
+    const size_t fileSize = (size_t)file->size();
+    const uint8_t *data = file->map(0, file->size());
+    if (!data) return false;
+
+    const std::string head((const char *)data, std::min(fileSize, (size_t)65536));
+    size_t bodyOffset = head.find("end_header");
+    if (bodyOffset == std::string::npos) return false;
+    bodyOffset = head.find('\n', bodyOffset);
+    if (bodyOffset == std::string::npos) return false;
+    bodyOffset += 1;
+
+    std::istringstream headStream(head.substr(0, bodyOffset));
+    std::vector<tinyply::PlyElement> elements;
+    try {
+        tinyply::PlyFile ply(headStream);
+        if (!ply.is_binary() || ply.is_big_endian()) return false;
+        elements = ply.get_elements();
+    } catch (const std::exception &) {
+        return false;
+    }
+
+    // Vertex and face must come first, so no list element has to be
+    // walked to find them
+    if (elements.size() < 2 || elements[0].name != "vertex" || elements[1].name != "face") {
+        return false;
+    }
+
+    const tinyply::PlyElement &vertex = elements[0];
+    int vertexStride = 0;
+    std::map<std::string, std::pair<int, PlyProperty::Type>> fields;
+    for (const auto &p : vertex.properties) {
+        if (p.isList) return false;
+        fields[p.name] = std::make_pair(vertexStride, p.propertyType);
+        vertexStride += tinyply::PropertyTable[p.propertyType].stride;
+    }
+
+    // Offset of consecutive properties of one type, -1 if they are not
+    // laid out like that
+    auto attribute = [&](std::initializer_list<const char *> names, PlyProperty::Type type) {
+        int offset = -1;
+        int k = 0;
+        for (const char *name : names) {
+            auto it = fields.find(name);
+            if (it == fields.end() || it->second.second != type) return -1;
+            if (k == 0) offset = it->second.first;
+            else if (it->second.first != offset + k * tinyply::PropertyTable[type].stride) return -1;
+            k++;
+        }
+        return offset;
+    };
+
+    const int posOffset = attribute({ "x", "y", "z" }, PlyProperty::Type::FLOAT32);
+    const int normalOffset = attribute({ "nx", "ny", "nz" }, PlyProperty::Type::FLOAT32);
+    const int colorOffset = attribute({ "red", "green", "blue", "alpha" }, PlyProperty::Type::UINT8);
+    if (posOffset < 0 || normalOffset < 0 || colorOffset < 0) return false;
+
+    // Faces must be triangles with 32-bit indices, so every record has
+    // the same size
+    const tinyply::PlyElement &face = elements[1];
+    int faceStride = 0;
+    int indexOffset = -1;
+    for (const auto &p : face.properties) {
+        if (p.isList) {
+            if (indexOffset >= 0 || p.name != "vertex_indices") return false;
+            if (tinyply::PropertyTable[p.propertyType].stride != sizeof(unsigned int)) return false;
+            if (tinyply::PropertyTable[p.listType].stride != 1) return false;
+            indexOffset = faceStride + 1;
+            faceStride += 1 + 3 * sizeof(unsigned int);
+        } else {
+            faceStride += tinyply::PropertyTable[p.propertyType].stride;
+        }
+    }
+    if (indexOffset < 0) return false;
+    if (!fitsCount((uint64_t)face.size * 3)) return false;
+
+    const size_t vertexBytes = (size_t)vertex.size * vertexStride;
+    const size_t faceBytes = (size_t)face.size * faceStride;
+    if (bodyOffset + vertexBytes + faceBytes > fileSize) return false;
+
+    const uint8_t *vertexData = data + bodyOffset;
+    const uint8_t *faceData = vertexData + vertexBytes;
+    for (int i = 0; i < face.size; i++) {
+        const uint8_t *record = faceData + (size_t)i * faceStride;
+        if (record[indexOffset - 1] != 3) return false;
+
+        unsigned int idx[3];
+        std::memcpy(idx, record + indexOffset, sizeof(idx));
+        if (idx[0] >= (unsigned int)vertex.size ||
+            idx[1] >= (unsigned int)vertex.size ||
+            idx[2] >= (unsigned int)vertex.size) {
+            return false;
+        }
+    }
+
+    mesh_->vertexCount = vertex.size;
+    mesh_->indexCount = face.size * 3;
+
+    const uint8_t *triangles = faceData + indexOffset;
+    const MeshView mesh = {
+        vertexData + posOffset, (size_t)vertexStride,
+        vertexData + normalOffset, (size_t)vertexStride,
+        vertexData + colorOffset, (size_t)vertexStride,
+        triangles, (size_t)faceStride
+    };
+    computeBounds(mesh);
+    mesh_->setPoints(samplePoints(mesh));
+
+    std::vector<unsigned int> indices;
+    std::vector<uint32_t> order;
+    size_t triangleStride = faceStride;
+    if (optimize_) {
+        indices.resize(mesh_->indexCount);
+        for (int t = 0; t < mesh_->indexCount / 3; t++) {
+            mesh.triangle(t, &indices[t * 3]);
+        }
+        order = optimizeMesh(mesh, indices);
+        triangles = (const uint8_t *)indices.data();
+        triangleStride = 3 * sizeof(unsigned int);
+    }
+
+    VertexFormat format = VertexFormat::create(layout_, mesh_->bboxMin, mesh_->bboxMax);
+    if (layout_ == VertexLayout::Float) {
+        // Point the float attributes into the file records
+        format.stride = vertexStride;
+        for (auto &a : format.attributes) {
+            switch (a.semantic) {
+            case VertexSemantic::Position: a.offset = posOffset; break;
+            case VertexSemantic::Normal:   a.offset = normalOffset; break;
+            case VertexSemantic::Color:    a.offset = colorOffset; break;
+            }
+        }
+    }
+    if (layout_ != VertexLayout::Float || optimize_) {
+        mesh_->setVertices(encodeVertices(format, mesh, order));
+    } else {
+        mesh_->mapping = file;
+        mesh_->vertices = vertexData;
+    }
+
+    finish(format, triangles, triangleStride);
+    writeCache(filename, triangles, triangleStride);
+    return true;
+}
+
+bool MeshLoader::parsePly(const std::string &filename, MeshData *mesh, int maxThreads) {
+    std::ifstream ifs(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!ifs.is_open()) {
+        std::cerr << "[ ERROR ] Failed to open file: " << filename << std::endl;
+        return false;
+    }
+
+    // tinyply throws on malformed or truncated files; loaders run on
+    // worker threads, where an escaping exception would end the program
+    *mesh = MeshData();
+    size_t faceCount = 0;
+    try {
+        tinyply::PlyFile file(ifs);
+        file.request_properties_from_element("vertex", {"x", "y", "z"}, mesh->positions);
+        file.request_properties_from_element("vertex", {"nx", "ny", "nz"}, mesh->normals);
+        file.request_properties_from_element("vertex", {"red", "green", "blue", "alpha"}, mesh->colors);
+        file.request_properties_from_element("face", {"vertex_indices"}, mesh->indices);
+        file.read(ifs, true, maxThreads);
+        for (const auto &e : file.get_elements()) {
+            if (e.name == "face") faceCount = (size_t)e.size;
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "[ERROR] failed to parse " << filename << ": " << e.what() << std::endl;
+        *mesh = MeshData();
+        return false;
+    }
+    ifs.close();
+
+    // The lists are flattened, so only all-triangle faces can be told
+    // apart, as in loadMapped()
+    const size_t nVertices = mesh->positions.size() / 3;
+    bool valid = mesh->indices.size() == faceCount * 3;
+    for (size_t i = 0; valid && i < mesh->indices.size(); i++) {
+        valid = mesh->indices[i] < nVertices;
+    }
+    if (!valid) {
+        std::cerr << "[ERROR] " << filename << ": faces must be triangles of valid vertices" << std::endl;
+        *mesh = MeshData();
+        return false;
+    }
+
+    // Attributes the file lacks are dropped rather than half-filled
+    if (mesh->normals.size() != mesh->positions.size()) mesh->normals.clear();
+    if (mesh->colors.size() != mesh->positions.size() / 3 * 4) mesh->colors.clear();
+    return true;
+}
+
+// Any other PLY goes through tinyply into CPU arrays first. They are
+// released on return.
+bool MeshLoader::loadParsed(const std::string &filename) {
+    MeshData data;
+    if (!parsePly(filename, &data, parseThreads_)) return false;
+    if (!fitsCount(data.positions.size() / 3) || !fitsCount(data.indices.size())) {
+        std::cerr << "[ERROR] mesh has too many vertices or triangles: " << filename << std::endl;
+        return false;
+    }
+
+    mesh_->vertexCount = (int)data.positions.size() / 3;
+    mesh_->indexCount = (int)data.indices.size();
+
+    const uint8_t *triangles = (const uint8_t *)data.indices.data();
+    const MeshView mesh = {
+        (const uint8_t *)data.positions.data(), 3 * sizeof(float),
+        data.normals.empty() ? nullptr : (const uint8_t *)data.normals.data(), 3 * sizeof(float),
+        data.colors.empty() ? nullptr : data.colors.data(), 4,
+        triangles, 3 * sizeof(unsigned int)
+    };
+    computeBounds(mesh);
+    mesh_->setPoints(samplePoints(mesh));
+
+    // Rewrites the indices; the view keeps reading the source order
+    std::vector<uint32_t> order;
+    if (optimize_) {
+        order = optimizeMesh(mesh, data.indices);
+    }
+
+    const VertexFormat format = VertexFormat::create(layout_, mesh_->bboxMin, mesh_->bboxMax);
+    mesh_->setVertices(encodeVertices(format, mesh, order));
+    finish(format, triangles, 3 * sizeof(unsigned int));
+    writeCache(filename, triangles, 3 * sizeof(unsigned int));
+    return true;
+}
+
+// Vertices and points stay in the mapped cache; nothing is parsed or
+// sampled
+bool MeshLoader::loadCached(const std::string &filename) {
+    auto cache = std::make_shared<MeshCache>(filename);
+    if (!cache->open() || cache->layout() != layout_) return false;
+    if (optimize_ && !cache->isOptimized()) return false;
+
+    const MeshCacheHeader &header = cache->header();
+    if (!fitsCount(header.vertexCount) || !fitsCount(header.indexCount)) return false;
+    mesh_->vertexCount = (int)header.vertexCount;
+    mesh_->indexCount = (int)header.indexCount;
+    mesh_->bboxMin = QVector3D(header.bboxMin[0], header.bboxMin[1], header.bboxMin[2]);
+    mesh_->bboxMax = QVector3D(header.bboxMax[0], header.bboxMax[1], header.bboxMax[2]);
+    mesh_->points = cache->points();
+    mesh_->pointCount = (int)header.pointCount;
+    mesh_->vertices = cache->vertices();
+    mesh_->mapping = cache;
+
+    finish(cache->format(), cache->indices(), 3 * sizeof(unsigned int));
+    return true;
+}
+
+void MeshLoader::finish(const VertexFormat &format, const uint8_t *triangles, size_t triangleStride) {
+    const int nVertices = mesh_->vertexCount;
+    const int indexCount = mesh_->indexCount;
+    const uint8_t *vertices = mesh_->vertices;
+    mesh_->format = format;
+    if (ownership_ == MeshOwnership::KeepCpuCopy) {
+        decodeMesh(format, vertices, nVertices, triangles, triangleStride, indexCount, &mesh_->cpuMesh);
+    }
+
+    // Clusters take 16-bit indices whenever every triangle fits a
+    // 64K window of vertices
+    mesh_->shortIndices = fitsShortIndices(triangles, triangleStride, indexCount);
+
+    std::vector<float> positions((size_t)nVertices * 3);
+    float normal[3];
+    uint8_t color[4];
+    for (int i = 0; i < nVertices; i++) {
+        format.decode(vertices + (size_t)i * format.stride, &positions[i * 3], normal, color);
+    }
+
+    mesh_->indices.resize(mesh_->indexBytes());
+    mesh_->clusters = buildClusters(triangles, triangleStride, indexCount, positions.data(),
+                                    mesh_->shortIndices, mesh_->indices.data());
+
+    std::cout << "[ INFO ] " << mesh_->clusters.size() << " clusters, "
+              << (mesh_->shortIndices ? 16 : 32) << "-bit indices" << std::endl;
+}
+
+void MeshLoader::writeCache(const std::string &filename, const uint8_t *triangles, size_t triangleStride) const {
+    MeshCache cache(filename);
+    const uint32_t flags = optimize_ ? MeshCacheHeader::FLAG_OPTIMIZED : 0;
+    if (cache.write(layout_, flags, mesh_->format, mesh_->vertices, (uint32_t)mesh_->vertexCount,
+                    triangles, triangleStride, (uint32_t)mesh_->indexCount,
+                    mesh_->points, (uint32_t)mesh_->pointCount,
+                    mesh_->bboxMin, mesh_->bboxMax)) {
+        std::cout << "[ INFO ] Mesh cache written: " << cache.path() << std::endl;
+    }
+}
+
+// Interleaves the view into records of the given format. Record i holds
+// vertex order[i], or vertex i if the order is empty.
+std::vector<uint8_t> MeshLoader::encodeVertices(const VertexFormat &format, const MeshView &mesh,
+                                                const std::vector<uint32_t> &order) const {
+    const int nVertices = mesh_->vertexCount;
+    std::vector<uint8_t> vertices((size_t)nVertices * format.stride, 0);
+    float p[3], n[3];
+    for (int i = 0; i < nVertices; i++) {
+        const size_t v = order.empty() ? (size_t)i : order[i];
+        std::memcpy(p, mesh.positions + v * mesh.positionStride, sizeof(p));
+        if (mesh.normals) {
+            std::memcpy(n, mesh.normals + v * mesh.normalStride, sizeof(n));
+        }
+        const uint8_t *color = mesh.colors ? mesh.colors + v * mesh.colorStride : nullptr;
+        format.encode(&vertices[(size_t)i * format.stride], p, mesh.normals ? n : nullptr, color);
+    }
+    return vertices;
+}
+
+// Reorders the triangles for the post-transform cache and overdraw, and
+// returns the vertex fetch order that the indices then refer to
+std::vector<uint32_t> MeshLoader::optimizeMesh(const MeshView &mesh, std::vector<unsigned int> &indices) const {
+    QElapsedTimer timer;
+    timer.start();
+
+    const size_t nVertices = (size_t)mesh_->vertexCount;
+    const VertexCacheStats before = analyzeVertexCache(indices.data(), indices.size(), nVertices);
+    std::vector<unsigned int> cacheOrder(indices.size());
+    optimizeVertexCache(cacheOrder.data(), indices.data(), indices.size(), nVertices);
+    optimizeOverdraw(indices.data(), cacheOrder.data(), indices.size(),
+                     mesh.positions, mesh.positionStride, nVertices);
+    std::vector<uint32_t> order = optimizeVertexFetch(indices.data(), indices.size(), nVertices);
+    const VertexCacheStats after = analyzeVertexCache(indices.data(), indices.size(), nVertices);
+
+    std::cout << "[ INFO ] Mesh optimized in " << timer.elapsed() << " ms: ACMR "
+              << before.acmr << " -> " << after.acmr << ", ATVR "
+              << before.atvr << " -> " << after.atvr << std::endl;
+    return order;
+}
+
+void MeshLoader::decodeMesh(const VertexFormat &format, const uint8_t *vertices, int nVertices,
+                            const uint8_t *triangles, size_t triangleStride, int indexCount, MeshData *mesh) {
+    mesh->positions.resize((size_t)nVertices * 3);
+    mesh->normals.resize((size_t)nVertices * 3);
+    mesh->colors.resize((size_t)nVertices * 4);
+    for (int i = 0; i < nVertices; i++) {
+        format.decode(vertices + (size_t)i * format.stride, &mesh->positions[i * 3],
+                      &mesh->normals[i * 3], &mesh->colors[i * 4]);
+    }
+
+    mesh->indices.resize(indexCount);
+    for (int t = 0; t < indexCount / 3; t++) {
+        std::memcpy(&mesh->indices[t * 3], triangles + t * triangleStride, 3 * sizeof(unsigned int));
+    }
+}
+
+void MeshLoader::computeBounds(const MeshView &mesh) {
+    QVector3D &lo = mesh_->bboxMin;
+    QVector3D &hi = mesh_->bboxMax;
+    lo = QVector3D( 1.0e20f,  1.0e20f,  1.0e20f);
+    hi = QVector3D(-1.0e20f, -1.0e20f, -1.0e20f);
+    for (int i = 0; i < mesh_->vertexCount; i++) {
+        const QVector3D p = mesh.position((unsigned int)i);
+        for (int k = 0; k < 3; k++) {
+            lo[k] = std::min(lo[k], p[k]);
+            hi[k] = std::max(hi[k], p[k]);
+        }
+    }
+}
+
+// Uniform, area-weighted random points on the triangles
+std::vector<float> MeshLoader::samplePoints(const MeshView &mesh) const {
+    const int nTris = mesh_->indexCount / 3;
+    std::vector<double> cdf(nTris + 1, 0.0);
+    unsigned int idx[3];
+    for (int i = 0; i < nTris; i++) {
+        mesh.triangle(i, idx);
+        const QVector3D p0 = mesh.position(idx[0]);
+        const QVector3D p1 = mesh.position(idx[1]);
+        const QVector3D p2 = mesh.position(idx[2]);
+        cdf[i + 1] = cdf[i] + 0.5 * QVector3D::crossProduct(p1 - p0, p2 - p0).length();
+    }
+
+    // Point clouds and fully degenerate meshes have no area to sample
+    if (nTris == 0 || cdf[nTris] <= 0.0) return std::vector<float>();
+
+    std::mt19937 rng(nTris);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::vector<float> points(POINT_SAMPLES * 3);
+    for (int i = 0; i < POINT_SAMPLES; i++) {
+        const double r = uniform(rng) * cdf[nTris];
+        const int found = (int)(std::upper_bound(cdf.begin(), cdf.end(), r) - cdf.begin()) - 1;
+        const int tri = std::min(std::max(found, 0), nTris - 1);
+        const float su = (float)std::sqrt(uniform(rng));
+        const float v = (float)uniform(rng);
+        mesh.triangle(tri, idx);
+        const QVector3D p = mesh.position(idx[0]) * (1.0f - su) +
+                            mesh.position(idx[1]) * (su * (1.0f - v)) +
+                            mesh.position(idx[2]) * (su * v);
+        points[i * 3 + 0] = p.x();
+        points[i * 3 + 1] = p.y();
+        points[i * 3 + 2] = p.z();
+    }
+    return points;
+}
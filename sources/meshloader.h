@@ -0,0 +1,167 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _MESH_LOADER_H_
+#define _MESH_LOADER_H_
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <QtGui/qvector3d.h>
+
+#include "meshcluster.h"
+#include "vertexformat.h"
+
+// CPU-side copy of a mesh: float3 positions and normals, ubyte4 colors
+// and triangle indices. Parsed files leave normals and colors empty when
+// they have none; decoded copies hold the defaults stored in the VBO.
+struct MeshData {
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<uint8_t> colors;
+    std::vector<unsigned int> indices;
+
+    inline size_t bytes() const {
+        return positions.size() * sizeof(float) + normals.size() * sizeof(float) +
+               colors.size() + indices.size() * sizeof(unsigned int);
+    }
+};
+
+// What a VertexArray retains once a mesh is uploaded.
+//   GpuOnly:     the GL buffers, draw counts and bounds. CPU arrays only
+//                live while loading.
+//   KeepCpuCopy: also a decoded MeshData, for consumers that read the
+//                mesh every frame.
+enum class MeshOwnership : int {
+    GpuOnly = 0x01,
+    KeepCpuCopy = 0x02
+};
+
+// A mesh ready for upload: the vertex records, the clustered index buffer
+// and the ISM point samples, all in memory so the upload does no file I/O.
+//
+// Vertices and points read from a mapped PLY body or mesh cache stay in
+// the mapping, which the mesh holds until it is dropped; only meshes that
+// were parsed or re-encoded own their arrays.
+struct PreparedMesh {
+    std::string filename;
+    const char *source = "";
+    VertexLayout layout = VertexLayout::Float;
+    VertexFormat format;
+
+    int vertexCount = 0;
+    int indexCount = 0;
+    QVector3D bboxMin;
+    QVector3D bboxMax;
+
+    // A QFile or MeshCache kept mapped for the views below
+    std::shared_ptr<void> mapping;
+
+    const uint8_t *vertices = nullptr;
+    std::vector<uint8_t> ownedVertices;
+
+    // Indices relative to each cluster's base vertex, 16 or 32 bits
+    bool shortIndices = false;
+    std::vector<uint8_t> indices;
+    std::vector<MeshCluster> clusters;
+
+    const float *points = nullptr;
+    int pointCount = 0;
+    std::vector<float> ownedPoints;
+
+    // Filled with MeshOwnership::KeepCpuCopy
+    MeshData cpuMesh;
+
+    inline size_t indexSize() const { return shortIndices ? sizeof(uint16_t) : sizeof(uint32_t); }
+    inline size_t vertexBytes() const { return (size_t)vertexCount * format.stride; }
+    inline size_t indexBytes() const { return (size_t)indexCount * indexSize(); }
+    inline size_t pointBytes() const { return (size_t)pointCount * 3 * sizeof(float); }
+
+    inline void setVertices(std::vector<uint8_t> data) {
+        ownedVertices = std::move(data);
+        vertices = ownedVertices.data();
+    }
+
+    inline void setPoints(std::vector<float> data) {
+        ownedPoints = std::move(data);
+        points = ownedPoints.data();
+        pointCount = (int)(ownedPoints.size() / 3);
+    }
+};
+
+// The CPU half of loading a mesh: reads it from its cache, straight from a
+// mapped binary PLY or through tinyply, in that order, then optimizes,
+// encodes and clusters it and refreshes the cache. No GL state is touched,
+// so loaders may run on worker threads.
+class MeshLoader {
+public:
+    explicit MeshLoader(VertexLayout layout = VertexLayout::Float, bool optimize = false,
+                        MeshOwnership ownership = MeshOwnership::GpuOnly);
+
+    bool load(const std::string &filename, PreparedMesh *mesh);
+
+    // Threads an ASCII PLY body is parsed on, 0 for one per hardware
+    // thread. Loaders that already run in parallel should use 1.
+    inline void setParseThreads(int threads) { parseThreads_ = threads; }
+
+    static bool parsePly(const std::string &filename, MeshData *mesh, int maxThreads = 0);
+
+    // Decodes interleaved records and strided triangles into a MeshData
+    static void decodeMesh(const VertexFormat &format, const uint8_t *vertices, int nVertices,
+                           const uint8_t *triangles, size_t triangleStride, int indexCount, MeshData *mesh);
+
+    // Point samples per mesh, used to splat imperfect shadow maps
+    static const int POINT_SAMPLES = 16384;
+
+private:
+    // Strided view of the vertex attributes and triangles, pointing either
+    // into the parsed arrays or straight into a mapped file. Normals and
+    // colors may be null.
+    struct MeshView {
+        const uint8_t *positions;
+        size_t positionStride;
+        const uint8_t *normals;
+        size_t normalStride;
+        const uint8_t *colors;
+        size_t colorStride;
+        const uint8_t *triangles;
+        size_t triangleStride;
+
+        inline QVector3D position(unsigned int i) const {
+            float p[3];
+            std::memcpy(p, positions + i * positionStride, sizeof(p));
+            return QVector3D(p[0], p[1], p[2]);
+        }
+
+        inline void triangle(int t, unsigned int idx[3]) const {
+            std::memcpy(idx, triangles + t * triangleStride, sizeof(unsigned int) * 3);
+        }
+    };
+
+    bool loadCached(const std::string &filename);
+    bool loadMapped(const std::string &filename);
+    bool loadParsed(const std::string &filename);
+
+    // Builds the clusters and the retained copy from the final records
+    void finish(const VertexFormat &format, const uint8_t *triangles, size_t triangleStride);
+
+    void writeCache(const std::string &filename, const uint8_t *triangles, size_t triangleStride) const;
+
+    std::vector<uint8_t> encodeVertices(const VertexFormat &format, const MeshView &mesh,
+                                        const std::vector<uint32_t> &order) const;
+    std::vector<uint32_t> optimizeMesh(const MeshView &mesh, std::vector<unsigned int> &indices) const;
+    void computeBounds(const MeshView &mesh);
+    std::vector<float> samplePoints(const MeshView &mesh) const;
+
+    VertexLayout layout_;
+    bool optimize_;
+    MeshOwnership ownership_;
+    int parseThreads_ = 0;
+    PreparedMesh *mesh_ = nullptr;
+};
+
+#endif  // _MESH_LOADER_H_
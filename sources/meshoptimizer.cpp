@@ -0,0 +1,306 @@
+#include "meshoptimizer.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+
+namespace {
+
+// Forsyth's scoring parameters, tuned for a 32-entry LRU cache
+const int FORSYTH_CACHE_SIZE = 32;
+const int FORSYTH_MAX_VALENCE = 32;
+const float CACHE_DECAY_POWER = 1.5f;
+const float LAST_TRIANGLE_SCORE = 0.75f;
+const float VALENCE_BOOST_SCALE = 2.0f;
+const float VALENCE_BOOST_POWER = 0.5f;
+
+// Cache restarts found by optimizeOverdraw are measured with this cache
+const int OVERDRAW_CACHE_SIZE = 16;
+
+struct ScoreTable {
+    float cache[FORSYTH_CACHE_SIZE];
+    float valence[FORSYTH_MAX_VALENCE + 1];
+
+    ScoreTable() {
+        for (int i = 0; i < FORSYTH_CACHE_SIZE; i++) {
+            if (i < 3) {
+                cache[i] = LAST_TRIANGLE_SCORE;
+            } else {
+                const float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+                cache[i] = std::pow(1.0f - (i - 3) * scaler, CACHE_DECAY_POWER);
+            }
+        }
+
+        valence[0] = 0.0f;
+        for (int i = 1; i <= FORSYTH_MAX_VALENCE; i++) {
+            valence[i] = VALENCE_BOOST_SCALE * std::pow((float)i, -VALENCE_BOOST_POWER);
+        }
+    }
+
+    // Vertices without live triangles are never picked
+    inline float score(int cachePosition, uint32_t liveTriangles) const {
+        if (liveTriangles == 0) return -1.0f;
+
+        const float valenceScore = liveTriangles <= (uint32_t)FORSYTH_MAX_VALENCE
+            ? valence[liveTriangles]
+            : VALENCE_BOOST_SCALE * std::pow((float)liveTriangles, -VALENCE_BOOST_POWER);
+        return (cachePosition >= 0 ? cache[cachePosition] : 0.0f) + valenceScore;
+    }
+};
+
+inline void readPosition(const uint8_t *positions, size_t stride, uint32_t v, float p[3]) {
+    std::memcpy(p, positions + v * stride, 3 * sizeof(float));
+}
+
+}  // anonymous namespace
+
+VertexCacheStats analyzeVertexCache(const uint32_t *indices, size_t indexCount, size_t vertexCount,
+                                    int cacheSize) {
+    VertexCacheStats stats;
+    if (indexCount < 3) return stats;
+
+    // A vertex is in the FIFO if it was inserted within the last
+    // cacheSize insertions
+    std::vector<uint32_t> timestamps(vertexCount, 0);
+    uint32_t timestamp = (uint32_t)cacheSize + 1;
+    size_t misses = 0;
+    size_t referenced = 0;
+    for (size_t i = 0; i < indexCount; i++) {
+        const uint32_t v = indices[i];
+        if (timestamps[v] == 0) referenced++;
+        if (timestamp - timestamps[v] > (uint32_t)cacheSize) {
+            timestamps[v] = timestamp++;
+            misses++;
+        }
+    }
+
+    stats.acmr = (double)misses / (double)(indexCount / 3);
+    stats.atvr = (double)misses / (double)referenced;
+    return stats;
+}
+
+void optimizeVertexCache(uint32_t *dest, const uint32_t *indices, size_t indexCount, size_t vertexCount) {
+    static const ScoreTable table;
+    const size_t triCount = indexCount / 3;
+    if (triCount == 0) return;
+
+    // Triangles of each vertex; the live ones are kept at the front
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < triCount * 3; i++) {
+        offsets[indices[i] + 1]++;
+    }
+    for (size_t v = 0; v < vertexCount; v++) {
+        offsets[v + 1] += offsets[v];
+    }
+
+    std::vector<uint32_t> adjacency(triCount * 3);
+    std::vector<uint32_t> live(vertexCount, 0);
+    for (size_t i = 0; i < triCount * 3; i++) {
+        const uint32_t v = indices[i];
+        adjacency[offsets[v] + live[v]++] = (uint32_t)(i / 3);
+    }
+
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        vertexScores[v] = table.score(-1, live[v]);
+    }
+
+    std::vector<float> triScores(triCount);
+    for (size_t t = 0; t < triCount; t++) {
+        const uint32_t *tri = indices + t * 3;
+        triScores[t] = vertexScores[tri[0]] + vertexScores[tri[1]] + vertexScores[tri[2]];
+    }
+
+    std::vector<char> emitted(triCount, 0);
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> next;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    next.reserve(FORSYTH_CACHE_SIZE + 3);
+
+    size_t cursor = 0;
+    int64_t best = -1;
+    for (size_t out = 0; out < triCount; out++) {
+        // Dead end: continue with the next triangle in input order
+        if (best < 0) {
+            while (emitted[cursor]) cursor++;
+            best = (int64_t)cursor;
+        }
+
+        const uint32_t *tri = indices + best * 3;
+        std::memcpy(dest + out * 3, tri, 3 * sizeof(uint32_t));
+        emitted[best] = 1;
+
+        for (int k = 0; k < 3; k++) {
+            const uint32_t v = tri[k];
+            uint32_t *adj = &adjacency[offsets[v]];
+            for (uint32_t j = 0; j < live[v]; j++) {
+                if (adj[j] == (uint32_t)best) {
+                    std::swap(adj[j], adj[live[v] - 1]);
+                    live[v]--;
+                    break;
+                }
+            }
+        }
+
+        // LRU update: the triangle's vertices move to the front
+        next.clear();
+        for (int k = 0; k < 3; k++) {
+            if (std::find(next.begin(), next.end(), tri[k]) == next.end()) {
+                next.push_back(tri[k]);
+            }
+        }
+        for (uint32_t v : cache) {
+            if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                next.push_back(v);
+            }
+        }
+
+        // Rescore everything that moved, including the evicted vertices
+        for (size_t i = 0; i < next.size(); i++) {
+            const uint32_t v = next[i];
+            const int position = i < (size_t)FORSYTH_CACHE_SIZE ? (int)i : -1;
+            const float score = table.score(position, live[v]);
+            const float delta = score - vertexScores[v];
+            vertexScores[v] = score;
+            const uint32_t *adj = &adjacency[offsets[v]];
+            for (uint32_t j = 0; j < live[v]; j++) {
+                triScores[adj[j]] += delta;
+            }
+        }
+        next.resize(std::min(next.size(), (size_t)FORSYTH_CACHE_SIZE));
+        std::swap(cache, next);
+
+        // Only triangles touching the cache changed score
+        best = -1;
+        float bestScore = -std::numeric_limits<float>::max();
+        for (uint32_t v : cache) {
+            const uint32_t *adj = &adjacency[offsets[v]];
+            for (uint32_t j = 0; j < live[v]; j++) {
+                if (triScores[adj[j]] > bestScore) {
+                    bestScore = triScores[adj[j]];
+                    best = adj[j];
+                }
+            }
+        }
+    }
+}
+
+void optimizeOverdraw(uint32_t *dest, const uint32_t *indices, size_t indexCount,
+                      const uint8_t *positions, size_t positionStride, size_t vertexCount) {
+    const size_t triCount = indexCount / 3;
+    if (triCount == 0) return;
+
+    // A cluster starts wherever all three vertices of a triangle miss
+    std::vector<size_t> starts;
+    std::vector<uint32_t> timestamps(vertexCount, 0);
+    uint32_t timestamp = OVERDRAW_CACHE_SIZE + 1;
+    for (size_t t = 0; t < triCount; t++) {
+        int misses = 0;
+        for (int k = 0; k < 3; k++) {
+            const uint32_t v = indices[t * 3 + k];
+            if (timestamp - timestamps[v] > (uint32_t)OVERDRAW_CACHE_SIZE) {
+                timestamps[v] = timestamp++;
+                misses++;
+            }
+        }
+        if (t == 0 || misses == 3) starts.push_back(t);
+    }
+    starts.push_back(triCount);
+
+    struct Cluster {
+        size_t begin;
+        size_t end;
+        double centroid[3];
+        double normal[3];
+        double area;
+        double key;
+    };
+
+    std::vector<Cluster> clusters(starts.size() - 1);
+    double meshCentroid[3] = { 0.0, 0.0, 0.0 };
+    double meshArea = 0.0;
+    for (size_t c = 0; c < clusters.size(); c++) {
+        Cluster &cluster = clusters[c];
+        std::memset(&cluster, 0, sizeof(cluster));
+        cluster.begin = starts[c];
+        cluster.end = starts[c + 1];
+
+        // Area-weighted centroid and summed (unnormalized) face normals
+        for (size_t t = cluster.begin; t < cluster.end; t++) {
+            float p0[3], p1[3], p2[3];
+            readPosition(positions, positionStride, indices[t * 3 + 0], p0);
+            readPosition(positions, positionStride, indices[t * 3 + 1], p1);
+            readPosition(positions, positionStride, indices[t * 3 + 2], p2);
+
+            const double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            const double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            const double n[3] = {
+                e1[1] * e2[2] - e1[2] * e2[1],
+                e1[2] * e2[0] - e1[0] * e2[2],
+                e1[0] * e2[1] - e1[1] * e2[0]
+            };
+            const double area = 0.5 * std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int k = 0; k < 3; k++) {
+                cluster.centroid[k] += area * (p0[k] + p1[k] + p2[k]) / 3.0;
+                cluster.normal[k] += n[k];
+            }
+            cluster.area += area;
+        }
+
+        for (int k = 0; k < 3; k++) {
+            meshCentroid[k] += cluster.centroid[k];
+        }
+        meshArea += cluster.area;
+    }
+
+    for (int k = 0; k < 3; k++) {
+        meshCentroid[k] /= std::max(meshArea, 1.0e-20);
+    }
+
+    // How far a cluster faces away from the middle of the mesh
+    for (auto &cluster : clusters) {
+        const double length = std::sqrt(cluster.normal[0] * cluster.normal[0] +
+                                        cluster.normal[1] * cluster.normal[1] +
+                                        cluster.normal[2] * cluster.normal[2]);
+        cluster.key = 0.0;
+        if (length <= 0.0 || cluster.area <= 0.0) continue;
+
+        for (int k = 0; k < 3; k++) {
+            const double c = cluster.centroid[k] / cluster.area;
+            cluster.key += (c - meshCentroid[k]) * cluster.normal[k] / length;
+        }
+    }
+
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster &a, const Cluster &b) {
+        return a.key > b.key;
+    });
+
+    size_t out = 0;
+    for (const auto &cluster : clusters) {
+        const size_t count = (cluster.end - cluster.begin) * 3;
+        std::memcpy(dest + out, indices + cluster.begin * 3, count * sizeof(uint32_t));
+        out += count;
+    }
+}
+
+std::vector<uint32_t> optimizeVertexFetch(uint32_t *indices, size_t indexCount, size_t vertexCount) {
+    const uint32_t UNUSED = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> remap(vertexCount, UNUSED);
+    std::vector<uint32_t> order;
+    order.reserve(vertexCount);
+
+    for (size_t i = 0; i < indexCount; i++) {
+        const uint32_t v = indices[i];
+        if (remap[v] == UNUSED) {
+            remap[v] = (uint32_t)order.size();
+            order.push_back(v);
+        }
+        indices[i] = remap[v];
+    }
+
+    for (size_t v = 0; v < vertexCount; v++) {
+        if (remap[v] == UNUSED) order.push_back((uint32_t)v);
+    }
+    return order;
+}
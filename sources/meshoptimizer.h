@@ -0,0 +1,41 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _MESH_OPTIMIZER_H_
+#define _MESH_OPTIMIZER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Post-transform cache efficiency of an index buffer, measured with a
+// FIFO cache.
+//   acmr: average cache misses per triangle (0.5 is ideal for a regular
+//         grid, 3.0 is no reuse at all)
+//   atvr: cache misses per referenced vertex (1.0 is ideal)
+struct VertexCacheStats {
+    double acmr = 0.0;
+    double atvr = 0.0;
+};
+
+VertexCacheStats analyzeVertexCache(const uint32_t *indices, size_t indexCount, size_t vertexCount,
+                                    int cacheSize = 16);
+
+// Reorders triangles for the post-transform cache with Forsyth's
+// linear-speed algorithm. dest must not alias indices.
+void optimizeVertexCache(uint32_t *dest, const uint32_t *indices, size_t indexCount, size_t vertexCount);
+
+// Reorders the clusters of a cache-optimized index buffer so outward
+// facing ones come first, which lets them occlude the rest. Clusters break
+// where the cache restarts, so the cache efficiency is kept. Positions are
+// float3 read with the given stride. dest must not alias indices.
+void optimizeOverdraw(uint32_t *dest, const uint32_t *indices, size_t indexCount,
+                      const uint8_t *positions, size_t positionStride, size_t vertexCount);
+
+// Renumbers vertices in order of first use and rewrites the indices in
+// place. Returns the new order as old vertex indices; unreferenced
+// vertices go last.
+std::vector<uint32_t> optimizeVertexFetch(uint32_t *indices, size_t indexCount, size_t vertexCount);
+
+#endif  // _MESH_OPTIMIZER_H_
@@ -1,33 +1,48 @@
 #include "openglviewer.h"
 
+#include <algorithm>
+
 #include <QtWidgets/qdialog.h>
 
 #include "common.h"
 #include "glutils.h"
+#include "smtechnique.h"
+#include "rsmtechnique.h"
+#include "ismtechnique.h"
 
-static const int SHADOWMAP_SIZE = 512;
-static const int nSamples = 64;
-static const float sampleRadius = 0.5f;
 static const QVector3D lightPos = QVector3D(0.0f, 9.0f, 0.0f);
+static const float lightNearPlane = 0.05f;
 
-QVector3D axes[6] = {
-    QVector3D(-1.0f,  0.0f,  0.0f),
-    QVector3D( 1.0f,  0.0f,  0.0f),
-    QVector3D( 0.0f, -1.0f,  0.0f),
-    QVector3D( 0.0f,  1.0f,  0.0f),
-    QVector3D( 0.0f,  0.0f, -1.0f),
-    QVector3D( 0.0f,  0.0f,  1.0f)
-};
+// Mesh data copied to the GPU per frame while a scene loads
+static const size_t uploadBytesPerFrame = 8 << 20;
 
 OpenGLViewer::OpenGLViewer(QWidget *parent)
     : QOpenGLWidget(parent)
     , QOpenGLFunctions() {
-    vao = new VertexArray();
+    scene = new Scene();
     camera = new ArcballCamera(this);
+    dumper = std::make_unique<ShadowMapDumper>();
+    targetPool = std::make_unique<RenderTargetPool>();
+    profiler = std::make_unique<Profiler>();
+
+    techniques[ShadowMapType::SM] = std::make_unique<SmTechnique>();
+    techniques[ShadowMapType::RSM] = std::make_unique<RsmTechnique>();
+    techniques[ShadowMapType::ISM] = std::make_unique<IsmTechnique>();
 }
 
 OpenGLViewer::~OpenGLViewer() {
-    delete vao;
+    makeCurrent();
+    dumper->release();
+    if (activeTechnique) {
+        activeTechnique->release();
+    }
+    emptyVao.reset();
+    scene->release();
+    profiler->release();
+    targetPool->clear();
+    doneCurrent();
+
+    delete scene;
     delete camera;
 }
 
@@ -38,123 +53,173 @@ void OpenGLViewer::initializeGL() {
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_CULL_FACE);
     glCullFace(GL_BACK);
+    glEnable(GL_PROGRAM_POINT_SIZE);
+
+    // The atlas is four faces wide
+    GLint maxTextureSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    maxShadowMapSize = std::min(maxShadowMapSize, (int)maxTextureSize / 4);
+    renderSettings.shadowMapSize = std::min(renderSettings.shadowMapSize, maxShadowMapSize);
+    emit shadowMapSizeLimit(maxShadowMapSize);
+
+    // Attribute-less full-screen passes still need a VAO in core profile
+    emptyVao = std::make_unique<QOpenGLVertexArrayObject>();
+    emptyVao->create();
     
-    vao->load(std::string(DATA_DIRECTORY) + "cbox.ply");
-    
-    shader = compileShader(std::string(SOURCE_DIRECTORY) + "shaders/render");
-    rsmShader = compileShader(std::string(SOURCE_DIRECTORY) + "shaders/rsm", true);
+    loadScene();
     
     camera->setLookAt(QVector3D(0.0f, 5.0f, 15.0f), QVector3D(0.0f, 5.0f, 0.0f), QVector3D(0.0f, 1.0f, 0.0f));
+}
 
-    randTexture = std::make_unique<QOpenGLTexture>(QOpenGLTexture::Target1D);
-    randTexture->create();
-    randTexture->setSize(nSamples * 2);
-    randTexture->setFormat(QOpenGLTexture::TextureFormat::R32F);
-    randTexture->allocateStorage();
-    
-    std::vector<float> randValues(nSamples * 2);
-    srand((unsigned long)time(0));
-    for (int i = 0; i < nSamples * 2; i++) {
-        randValues[i] = rand() / (float)RAND_MAX;
+void OpenGLViewer::requestShadowMapDump(DumpFormat format) {
+    dumper->request(format);
+    update();
+}
+
+void OpenGLViewer::setSettings(const RenderSettings &settings) {
+    renderSettings = settings;
+    renderSettings.validate();
+    renderSettings.shadowMapSize = std::min(renderSettings.shadowMapSize, maxShadowMapSize);
+    update();
+}
+
+std::string OpenGLViewer::sceneFilename() const {
+    if (renderSettings.scene.isEmpty()) {
+        return std::string(DATA_DIRECTORY) + "cbox.ply";
+    }
+    return renderSettings.scene.toStdString();
+}
+
+// Returns at once; the meshes arrive over the following frames
+void OpenGLViewer::loadScene() {
+    scene->load(sceneFilename(), renderSettings.vertexLayout, renderSettings.optimizeMesh);
+    setupLight();
+    reportProgress();
+}
+
+// The light's clip planes follow the scene bounds
+void OpenGLViewer::setupLight() {
+    light.setup(lightPos, scene->bboxMin(), scene->bboxMax(), lightNearPlane);
+}
+
+RenderContext OpenGLViewer::renderContext() {
+    RenderContext ctx;
+    ctx.scene = scene;
+    ctx.camera = camera;
+    ctx.targetPool = targetPool.get();
+    ctx.dumper = dumper.get();
+    ctx.emptyVao = emptyVao.get();
+    ctx.profiler = profiler.get();
+    ctx.light = light;
+    glGetIntegerv(GL_VIEWPORT, ctx.viewport);
+
+    ctx.settings = renderSettings;
+    return ctx;
+}
+
+ShadowTechnique *OpenGLViewer::activateTechnique(ShadowMapType type, const RenderContext &ctx) {
+    ShadowTechnique *technique = techniques[type].get();
+    if (technique == activeTechnique) {
+        return technique;
     }
 
-    randTexture->setData(0, 0, QOpenGLTexture::Red, QOpenGLTexture::Float32, &randValues[0], 0);
-    
-    cubeViewMat.resize(6);
-    for (int i = 0; i < 6; i++) {
-        QVector3D center = lightPos + axes[i];
-        QVector3D up(0.0f, 1.0f, 0.0f);
-        if (QVector3D::crossProduct(axes[i], up).length() < 0.01f) {
-            up = QVector3D(1.0f, 0.0f, 0.0f);
-        }
-        cubeViewMat[i].lookAt(lightPos, center, up);
+    // Free the previous technique before the next one allocates, so that
+    // the pool can hand over targets of matching size and format.
+    if (activeTechnique) {
+        activeTechnique->release();
     }
+    technique->initialize(ctx);
+    targetPool->trim();
+    profiler->clearHistory();
+
+    activeTechnique = technique;
+    return technique;
 }
 
 void OpenGLViewer::paintGL() {
-    // Shadow mapping
-    int viewport[4];
-    glGetIntegerv(GL_VIEWPORT, viewport);
+    profiler->beginFrame();
 
-    glViewport(0, 0, SHADOWMAP_SIZE * 4, SHADOWMAP_SIZE * 3);
+    // Hand finished debug readbacks to the encoder threads
+    profiler->beginPass("setup");
+    dumper->poll();
 
-    rsmShader->bind();
-    rsmFbo->bind();
-    
-    QMatrix4x4 pMat, mvMat;
-    pMat.ortho(-10.0f, 10.0f, -10.0f, 10.0f, 0.01f, 10.0f);
-    QMatrix4x4 mvpMat = pMat * mvMat;
-    
-    auto f = QOpenGLContext::currentContext()->extraFunctions();
-    GLenum bufs[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1,
-                      GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3 };
-    f->glDrawBuffers(4, bufs);
+    if (scene->filename() != sceneFilename() || scene->layout() != renderSettings.vertexLayout ||
+        scene->optimize() != renderSettings.optimizeMesh) {
+        loadScene();
+    }
+    if (scene->update(uploadBytesPerFrame)) {
+        setupLight();
+    }
+    reportProgress();
 
-    rsmShader->setUniformValue("u_projMat", pMat);
-    rsmShader->setUniformValueArray("u_mvMat", &cubeViewMat[0], 6);
+    const RenderContext ctx = renderContext();
+    ShadowTechnique *technique = activateTechnique(renderSettings.mode, ctx);
+    technique->render(ctx);
 
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    
-    float white[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
-    f->glClearBufferfv(GL_COLOR, 0, white);
-    
-    vao->draw(*rsmShader);
-    
-    rsmShader->release();
-    rsmFbo->release();
-    
-    rsmFbo->toImage(true, 0).save(QString(OUTPUT_DIRECTORY) + "depth.png");
-    rsmFbo->toImage(true, 1).save(QString(OUTPUT_DIRECTORY) + "position.png");
-    rsmFbo->toImage(true, 2).save(QString(OUTPUT_DIRECTORY) + "normal.png");
-    rsmFbo->toImage(true, 3).save(QString(OUTPUT_DIRECTORY) + "diffuse.png");
-    
-    // Rendering
-    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    profiler->endFrame();
+    reportTimings();
 
-    shader->bind();
-    
-    QVector<GLuint> textures = rsmFbo->textures();
-    for (int i = 0; i < textures.size(); i++) {
-        glActiveTexture(GL_TEXTURE0 + i);
-        glBindTexture(GL_TEXTURE_2D, textures[i]);
+    // Keep polling until outstanding readbacks and uploads are complete,
+    // and drawing until a temporal technique has converged
+    if (dumper->hasPending() || profiler->isRecording() || scene->isLoading() ||
+        technique->isConverging()) {
+        update();
     }
-    
-    shader->setUniformValue("u_mvMat", camera->mvMat());
-    shader->setUniformValue("u_mvpMat", camera->mvpMat());
-    shader->setUniformValue("u_lightPos", lightPos);
-    
-    shader->setUniformValue("u_depthMap", 0);
-    shader->setUniformValue("u_positionMap", 1);
-    shader->setUniformValue("u_normalMap", 2);
-    shader->setUniformValue("u_diffuseMap", 3);
-    
-    glActiveTexture(GL_TEXTURE4);
-    glBindTexture(GL_TEXTURE_1D, randTexture->textureId());
-    shader->setUniformValue("u_randMap", 4);
-    
-    shader->setUniformValue("u_lightMvpMat", mvpMat);
-    shader->setUniformValue("u_nSamples", nSamples);
-    shader->setUniformValue("u_sampleRadius", sampleRadius);
+}
 
-    vao->draw(*shader);
-    
-    shader->release();
+void OpenGLViewer::startProfileRecording() {
+    profiler->startRecording();
+    update();
+}
+
+void OpenGLViewer::stopProfileRecording(const QString &filename) {
+    // Results still in flight are dropped; the GPU is a few frames behind
+    profiler->stopRecording(filename.toStdString());
+}
+
+void OpenGLViewer::reportTimings() {
+    const Profiler::FrameTiming avg = profiler->average();
+    if (avg.frame < 0) return;
+
+    QString text = QString("Frame: GPU %1 ms, CPU %2 ms")
+        .arg(avg.gpuMs(), 0, 'f', 2).arg(avg.cpuMs, 0, 'f', 2);
+    for (const auto &p : avg.passes) {
+        text += QString("\n  %1: GPU %2 ms, CPU %3 ms").arg(p.name.c_str())
+            .arg(p.gpuMs, 0, 'f', 2).arg(p.cpuMs, 0, 'f', 2);
+    }
+
+    if (activeTechnique) {
+        const CullStats cull = activeTechnique->cullStats();
+        if (cull.submitted > 0) {
+            const double culled = 100.0 * (1.0 - (double)cull.emitted / cull.submitted);
+            text += QString("\nShadow pass: %1 / %2 tris (%3% culled)")
+                .arg(cull.emitted).arg(cull.submitted).arg(culled, 0, 'f', 1);
+        }
+        if (cull.shadowClusters > 0 || cull.cameraClusters > 0) {
+            text += QString("\nClusters: shadow %1 / %3, camera %2 / %3")
+                .arg(cull.shadowClusters).arg(cull.cameraClusters).arg(scene->clusterCount());
+        }
+    }
+
+    const RenderTargetPool::Stats &pool = renderTargetStats();
+    text += QString("\nRender targets: %1 MB (peak %2 MB), %3 allocated, %4 reused")
+        .arg(pool.bytes / (1024 * 1024)).arg(pool.peakBytes / (1024 * 1024))
+        .arg(pool.allocations).arg(pool.reuses);
+    emit timingsChanged(text);
+}
+
+void OpenGLViewer::reportProgress() {
+    const int percent = scene->isLoading() ? std::min(99, (int)(100.0f * scene->progress())) : 100;
+    if (percent == loadingPercent) return;
+
+    loadingPercent = percent;
+    emit loadingProgress(percent);
 }
 
 void OpenGLViewer::resizeGL(int w, int h) {
     glViewport(0, 0, width(), height());
 
     camera->setPerspective(45.0f, (float)width() / (float)height(), 0.1f, 100.0f);
-    
-    rsmFbo = std::make_unique<QOpenGLFramebufferObject>(
-        SHADOWMAP_SIZE * 4, SHADOWMAP_SIZE * 3,
-        QOpenGLFramebufferObject::Attachment::Depth,
-        GL_TEXTURE_2D, GL_RGBA32F
-    );
-    rsmFbo->addColorAttachment(SHADOWMAP_SIZE * 4, SHADOWMAP_SIZE * 3);
-    rsmFbo->addColorAttachment(SHADOWMAP_SIZE * 4, SHADOWMAP_SIZE * 3);
-    rsmFbo->addColorAttachment(SHADOWMAP_SIZE * 4, SHADOWMAP_SIZE * 3);
 }
 
 void OpenGLViewer::mousePressEvent(QMouseEvent *ev) {
@@ -5,22 +5,22 @@
 #ifndef _OPENGL_VIEWER_H_
 #define _OPENGL_VIEWER_H_
 
+#include <map>
 #include <memory>
 
 #include <QtWidgets/qopenglwidget.h>
 #include <QtGui/qopenglshaderprogram.h>
 #include <QtGui/qopenglfunctions.h>
-#include <QtGui/qopenglframebufferobject.h>
-#include <QtGui/qopengltexture.h>
+#include <QtGui/qopenglvertexarrayobject.h>
 
-#include "vertexarray.h"
+#include "scene.h"
 #include "arcballcamera.h"
-
-enum class ShadowMapType : int {
-    SM = 0x01,
-    RSM = 0x02,
-    ISM = 0x04
-};
+#include "shadowmapdumper.h"
+#include "rendertarget.h"
+#include "rsmformat.h"
+#include "rendersettings.h"
+#include "shadowtechnique.h"
+#include "profiler.h"
 
 class OpenGLViewer : public QOpenGLWidget, protected QOpenGLFunctions {
     Q_OBJECT
@@ -29,9 +29,29 @@ public:
     explicit OpenGLViewer(QWidget *parent = nullptr);
     virtual ~OpenGLViewer();
     
-    inline void setShadowMode(ShadowMapType type) {
-        smType = type;
+    // Techniques rebuild only what the changed values affect on the next frame
+    void setSettings(const RenderSettings &settings);
+    inline const RenderSettings &settings() const { return renderSettings; }
+
+    void requestShadowMapDump(DumpFormat format);
+
+    // Frames render continuously while a profile is being recorded
+    void startProfileRecording();
+    void stopProfileRecording(const QString &filename);
+
+    inline const RenderTargetPool::Stats &renderTargetStats() const {
+        return targetPool->stats();
     }
+
+signals:
+    void timingsChanged(const QString &text);
+
+    // 0 to 100 while a scene loads; 100 once it is complete
+    void loadingProgress(int percent);
+
+    // Largest face size whose 4x3 atlas fits GL_MAX_TEXTURE_SIZE, sent
+    // once the context exists
+    void shadowMapSizeLimit(int maxSize);
     
 protected:
     void initializeGL() override;
@@ -44,18 +64,31 @@ protected:
     void wheelEvent(QWheelEvent *ev) override;
 
 private:
-    VertexArray *vao = nullptr;
+    RenderContext renderContext();
+    ShadowTechnique *activateTechnique(ShadowMapType type, const RenderContext &ctx);
+    void reportTimings();
+    void reportProgress();
+    std::string sceneFilename() const;
+    void loadScene();
+    void setupLight();
+
+    Scene *scene = nullptr;
     ArcballCamera *camera = nullptr;
+
+    // Only the active technique holds GL resources
+    std::map<ShadowMapType, std::unique_ptr<ShadowTechnique>> techniques;
+    ShadowTechnique *activeTechnique = nullptr;
+    RenderSettings renderSettings;
+    int maxShadowMapSize = 4096;
+
+    std::unique_ptr<RenderTargetPool> targetPool = nullptr;
+    std::unique_ptr<QOpenGLVertexArrayObject> emptyVao = nullptr;
+
+    std::unique_ptr<ShadowMapDumper> dumper = nullptr;
     
-    std::unique_ptr<QOpenGLShaderProgram> shader = nullptr;
-    
-    std::unique_ptr<QOpenGLShaderProgram> rsmShader = nullptr;
-    std::unique_ptr<QOpenGLFramebufferObject> rsmFbo = nullptr;
-    
-    std::unique_ptr<QOpenGLTexture> randTexture = nullptr;
-    
-    std::vector<QMatrix4x4> cubeViewMat;
-    ShadowMapType smType;
+    LightCube light;
+    std::unique_ptr<Profiler> profiler = nullptr;
+    int loadingPercent = 100;
 };
 
 #endif  // _OPENGL_VIEWER_H_
@@ -0,0 +1,229 @@
+#include "profiler.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+#include "glutils.h"
+
+namespace {
+
+// Frames whose results are still outstanding after this many are dropped
+const int MAX_PENDING_FRAMES = 16;
+
+bool endsWith(const std::string &str, const std::string &suffix) {
+    return str.size() >= suffix.size() &&
+           str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+}  // anonymous namespace
+
+double Profiler::FrameTiming::gpuMs() const {
+    double sum = 0.0;
+    for (const auto &p : passes) {
+        sum += p.gpuMs;
+    }
+    return sum;
+}
+
+Profiler::Profiler(int historySize)
+    : historySize_(historySize) {
+}
+
+Profiler::~Profiler() {
+}
+
+void Profiler::beginFrame() {
+    auto f = glCoreFunctions();
+    collect(f);
+
+    current_.frame = frameIndex_++;
+    current_.cpuMs = 0.0;
+    current_.passes.clear();
+    frameTimer_.start();
+    inFrame_ = true;
+}
+
+void Profiler::endFrame() {
+    if (!inFrame_) return;
+
+    endPass();
+    current_.cpuMs = frameTimer_.nsecsElapsed() * 1.0e-6;
+    pending_.push_back(current_);
+    inFrame_ = false;
+
+    if ((int)pending_.size() > MAX_PENDING_FRAMES) {
+        for (const auto &p : pending_.front().passes) {
+            freeQueries_.push_back(p.query);
+        }
+        pending_.pop_front();
+    }
+}
+
+void Profiler::beginPass(const std::string &name) {
+    if (!inFrame_) return;
+
+    endPass();
+
+    auto f = glCoreFunctions();
+    const GLuint query = acquireQuery(f);
+    f->glBeginQuery(GL_TIME_ELAPSED, query);
+    current_.passes.push_back({ name, query, 0.0 });
+    passTimer_.start();
+    inPass_ = true;
+}
+
+void Profiler::endPass() {
+    if (!inPass_) return;
+
+    glCoreFunctions()->glEndQuery(GL_TIME_ELAPSED);
+    current_.passes.back().cpuMs = passTimer_.nsecsElapsed() * 1.0e-6;
+    inPass_ = false;
+}
+
+void Profiler::release() {
+    auto f = glCoreFunctions();
+    for (const auto &frame : pending_) {
+        for (const auto &p : frame.passes) {
+            f->glDeleteQueries(1, &p.query);
+        }
+    }
+    pending_.clear();
+
+    if (!freeQueries_.empty()) {
+        f->glDeleteQueries((GLsizei)freeQueries_.size(), &freeQueries_[0]);
+        freeQueries_.clear();
+    }
+}
+
+void Profiler::collect(QOpenGLFunctions_3_3_Core *f) {
+    while (!pending_.empty()) {
+        const PendingFrame &frame = pending_.front();
+
+        // Queries complete in submission order, so the last one decides
+        if (!frame.passes.empty()) {
+            GLint available = 0;
+            f->glGetQueryObjectiv(frame.passes.back().query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) break;
+        }
+
+        FrameTiming timing;
+        timing.frame = frame.frame;
+        timing.cpuMs = frame.cpuMs;
+        for (const auto &p : frame.passes) {
+            GLuint64 ns = 0;
+            f->glGetQueryObjectui64v(p.query, GL_QUERY_RESULT, &ns);
+            timing.passes.push_back({ p.name, ns * 1.0e-6, p.cpuMs });
+            freeQueries_.push_back(p.query);
+        }
+        pending_.pop_front();
+
+        history_.push_back(timing);
+        if ((int)history_.size() > historySize_) {
+            history_.pop_front();
+        }
+        if (recording_) {
+            recorded_.push_back(timing);
+        }
+    }
+}
+
+GLuint Profiler::acquireQuery(QOpenGLFunctions_3_3_Core *f) {
+    if (freeQueries_.empty()) {
+        GLuint query = 0;
+        f->glGenQueries(1, &query);
+        return query;
+    }
+
+    const GLuint query = freeQueries_.back();
+    freeQueries_.pop_back();
+    return query;
+}
+
+Profiler::FrameTiming Profiler::average() const {
+    FrameTiming avg;
+    avg.frame = -1;
+    avg.cpuMs = 0.0;
+    if (history_.empty()) return avg;
+
+    std::map<std::string, std::pair<PassTiming, int>> sums;
+    for (const auto &frame : history_) {
+        avg.cpuMs += frame.cpuMs;
+        for (const auto &p : frame.passes) {
+            auto &s = sums[p.name];
+            s.first.gpuMs += p.gpuMs;
+            s.first.cpuMs += p.cpuMs;
+            s.second++;
+        }
+    }
+    avg.frame = history_.back().frame;
+    avg.cpuMs /= history_.size();
+
+    for (const auto &p : history_.back().passes) {
+        const auto &s = sums[p.name];
+        avg.passes.push_back({ p.name, s.first.gpuMs / s.second, s.first.cpuMs / s.second });
+    }
+    return avg;
+}
+
+void Profiler::startRecording() {
+    recorded_.clear();
+    recording_ = true;
+}
+
+bool Profiler::stopRecording(const std::string &filename) {
+    recording_ = false;
+
+    const bool success = endsWith(filename, ".json") ? writeJson(filename) : writeCsv(filename);
+    if (success) {
+        std::cout << "[ INFO ] " << recorded_.size() << " profiled frames written to " << filename << std::endl;
+    }
+    recorded_.clear();
+    return success;
+}
+
+bool Profiler::writeCsv(const std::string &filename) const {
+    std::ofstream writer(filename.c_str(), std::ios::out);
+    if (writer.fail()) {
+        std::cerr << "[ERROR] failed to open file: " << filename << std::endl;
+        return false;
+    }
+
+    writer << std::fixed << std::setprecision(4);
+    writer << "frame,pass,gpu_ms,cpu_ms" << std::endl;
+    for (const auto &frame : recorded_) {
+        for (const auto &p : frame.passes) {
+            writer << frame.frame << "," << p.name << "," << p.gpuMs << "," << p.cpuMs << std::endl;
+        }
+        writer << frame.frame << ",total," << frame.gpuMs() << "," << frame.cpuMs << std::endl;
+    }
+    return true;
+}
+
+bool Profiler::writeJson(const std::string &filename) const {
+    std::ofstream writer(filename.c_str(), std::ios::out);
+    if (writer.fail()) {
+        std::cerr << "[ERROR] failed to open file: " << filename << std::endl;
+        return false;
+    }
+
+    writer << std::fixed << std::setprecision(4);
+    writer << "[" << std::endl;
+    for (size_t i = 0; i < recorded_.size(); i++) {
+        const FrameTiming &frame = recorded_[i];
+        writer << "  { \"frame\": " << frame.frame
+               << ", \"gpu_ms\": " << frame.gpuMs()
+               << ", \"cpu_ms\": " << frame.cpuMs
+               << ", \"passes\": [";
+        for (size_t k = 0; k < frame.passes.size(); k++) {
+            const PassTiming &p = frame.passes[k];
+            writer << (k == 0 ? " " : ", ")
+                   << "{ \"name\": \"" << p.name << "\", \"gpu_ms\": " << p.gpuMs
+                   << ", \"cpu_ms\": " << p.cpuMs << " }";
+        }
+        writer << " ] }" << (i + 1 < recorded_.size() ? "," : "") << std::endl;
+    }
+    writer << "]" << std::endl;
+    return true;
+}
@@ -0,0 +1,95 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <string>
+#include <vector>
+#include <deque>
+
+#include <QtCore/qelapsedtimer.h>
+#include <QtGui/qopenglfunctions_3_3_core.h>
+
+// Per-pass GPU and CPU frame timings.
+//
+// Passes are flat: beginPass() closes the pass that is still open, because
+// GL_TIME_ELAPSED queries cannot nest. GPU results are read back only once
+// they are available, typically a few frames later, so the profiler never
+// waits on the GPU. Query objects are recycled through a free list.
+class Profiler {
+public:
+    struct PassTiming {
+        std::string name;
+        double gpuMs;
+        double cpuMs;
+    };
+
+    struct FrameTiming {
+        int frame;
+        double cpuMs;
+        std::vector<PassTiming> passes;
+
+        double gpuMs() const;
+    };
+
+    explicit Profiler(int historySize = 120);
+    virtual ~Profiler();
+
+    void beginFrame();
+    void endFrame();
+    void beginPass(const std::string &name);
+    void endPass();
+
+    void release();
+
+    // Mean over the completed frames in the history. Passes are listed in
+    // the order they ran in the latest frame.
+    FrameTiming average() const;
+    inline const std::deque<FrameTiming> &history() const { return history_; }
+    inline void clearHistory() { history_.clear(); }
+
+    // Every completed frame between start and stop is kept. The file
+    // format follows the extension: .json, anything else is CSV.
+    void startRecording();
+    bool stopRecording(const std::string &filename);
+    inline bool isRecording() const { return recording_; }
+
+private:
+    struct PendingPass {
+        std::string name;
+        GLuint query;
+        double cpuMs;
+    };
+
+    struct PendingFrame {
+        int frame;
+        double cpuMs;
+        std::vector<PendingPass> passes;
+    };
+
+    void collect(QOpenGLFunctions_3_3_Core *f);
+    GLuint acquireQuery(QOpenGLFunctions_3_3_Core *f);
+
+    bool writeCsv(const std::string &filename) const;
+    bool writeJson(const std::string &filename) const;
+
+    int historySize_;
+    int frameIndex_ = 0;
+    bool inFrame_ = false;
+    bool inPass_ = false;
+
+    PendingFrame current_;
+    QElapsedTimer frameTimer_;
+    QElapsedTimer passTimer_;
+
+    std::deque<PendingFrame> pending_;
+    std::vector<GLuint> freeQueries_;
+    std::deque<FrameTiming> history_;
+
+    bool recording_ = false;
+    std::vector<FrameTiming> recorded_;
+};
+
+#endif  // _PROFILER_H_
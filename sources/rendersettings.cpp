@@ -0,0 +1,164 @@
+#include "rendersettings.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include <QtCore/qfileinfo.h>
+#include <QtCore/qsettings.h>
+#include <QtCore/qcommandlineparser.h>
+
+namespace {
+
+ShadowMapType modeFromString(const QString &str, ShadowMapType fallback) {
+    const QString s = str.toLower();
+    if (s == "sm")  return ShadowMapType::SM;
+    if (s == "rsm") return ShadowMapType::RSM;
+    if (s == "ism") return ShadowMapType::ISM;
+    std::cerr << "[ERROR] unknown shadow mode: " << str.toStdString() << std::endl;
+    return fallback;
+}
+
+ShadowMapLayout layoutFromString(const QString &str, ShadowMapLayout fallback) {
+    const QString s = str.toLower();
+    if (s == "atlas")   return ShadowMapLayout::Atlas;
+    if (s == "layered") return ShadowMapLayout::Layered;
+    std::cerr << "[ERROR] unknown shadow map layout: " << str.toStdString() << std::endl;
+    return fallback;
+}
+
+RsmFormat formatFromString(const QString &str, RsmFormat fallback) {
+    const QString s = str.toLower();
+    if (s == "compact") return RsmFormat::Compact;
+    if (s == "full")    return RsmFormat::Full;
+    std::cerr << "[ERROR] unknown RSM format: " << str.toStdString() << std::endl;
+    return fallback;
+}
+
+VertexLayout vertexLayoutFromString(const QString &str, VertexLayout fallback) {
+    const QString s = str.toLower();
+    if (s == "float")     return VertexLayout::Float;
+    if (s == "quantized") return VertexLayout::Quantized;
+    std::cerr << "[ERROR] unknown vertex layout: " << str.toStdString() << std::endl;
+    return fallback;
+}
+
+}  // anonymous namespace
+
+bool RenderSettings::load(const QString &filename) {
+    if (!QFileInfo(filename).exists()) {
+        std::cerr << "[ERROR] settings file not found: " << filename.toStdString() << std::endl;
+        return false;
+    }
+
+    QSettings ini(filename, QSettings::IniFormat);
+    if (ini.contains("shadow/mode")) {
+        mode = modeFromString(ini.value("shadow/mode").toString(), mode);
+    }
+    if (ini.contains("shadow/layout")) {
+        layout = layoutFromString(ini.value("shadow/layout").toString(), layout);
+    }
+    shadowMapSize = ini.value("shadow/size", shadowMapSize).toInt();
+    if (ini.contains("rsm/format")) {
+        rsmFormat = formatFromString(ini.value("rsm/format").toString(), rsmFormat);
+    }
+    nSamples = ini.value("rsm/samples", nSamples).toInt();
+    sampleRadius = ini.value("rsm/radius", sampleRadius).toFloat();
+    indirectDownsample = ini.value("rsm/downsample", indirectDownsample).toInt();
+    temporal = ini.value("rsm/temporal", temporal).toBool();
+    rsmHierarchy = ini.value("rsm/hierarchical", rsmHierarchy).toBool();
+    vplCount = ini.value("ism/vpls", vplCount).toInt();
+    if (ini.contains("mesh/layout")) {
+        vertexLayout = vertexLayoutFromString(ini.value("mesh/layout").toString(), vertexLayout);
+    }
+    optimizeMesh = ini.value("mesh/optimize", optimizeMesh).toBool();
+    clusterCulling = ini.value("mesh/culling", clusterCulling).toBool();
+    deferred = ini.value("render/deferred", deferred).toBool();
+    scene = ini.value("scene/file", scene).toString();
+
+    validate();
+    return true;
+}
+
+void RenderSettings::addOptions(QCommandLineParser &parser) {
+    parser.addOption(QCommandLineOption("config", "Load settings from an INI file.", "file"));
+    parser.addOption(QCommandLineOption("mode", "Shadow mode: sm, rsm or ism.", "mode"));
+    parser.addOption(QCommandLineOption("layout", "Cube face storage: atlas or layered.", "layout"));
+    parser.addOption(QCommandLineOption("rsm-format", "RSM storage: compact or full.", "format"));
+    parser.addOption(QCommandLineOption("shadow-size", "Shadow map texels per cube face.", "size"));
+    parser.addOption(QCommandLineOption("samples", "RSM gather samples per pixel.", "count"));
+    parser.addOption(QCommandLineOption("radius", "RSM gather radius.", "radius"));
+    parser.addOption(QCommandLineOption("indirect-downsample", "RSM indirect light resolution divisor: 1, 2 or 4.", "factor"));
+    parser.addOption(QCommandLineOption("temporal", "Accumulate RSM indirect light over frames."));
+    parser.addOption(QCommandLineOption("rsm-hierarchy", "Gather distant RSM samples from a mip chain."));
+    parser.addOption(QCommandLineOption("vpls", "Number of ISM virtual point lights.", "count"));
+    parser.addOption(QCommandLineOption("vertex-layout", "Mesh vertex storage: float or quantized.", "layout"));
+    parser.addOption(QCommandLineOption("optimize-mesh", "Reorder the mesh for the vertex cache on load."));
+    parser.addOption(QCommandLineOption("no-cluster-culling", "Draw every mesh cluster in every pass."));
+    parser.addOption(QCommandLineOption("deferred", "Shade from a G-buffer in full-screen passes."));
+    parser.addOption(QCommandLineOption("scene", "Scene file or PLY mesh to load.", "file"));
+}
+
+void RenderSettings::parse(const QCommandLineParser &parser) {
+    if (parser.isSet("config")) {
+        load(parser.value("config"));
+    }
+
+    if (parser.isSet("mode")) {
+        mode = modeFromString(parser.value("mode"), mode);
+    }
+    if (parser.isSet("layout")) {
+        layout = layoutFromString(parser.value("layout"), layout);
+    }
+    if (parser.isSet("rsm-format")) {
+        rsmFormat = formatFromString(parser.value("rsm-format"), rsmFormat);
+    }
+    if (parser.isSet("shadow-size")) {
+        shadowMapSize = parser.value("shadow-size").toInt();
+    }
+    if (parser.isSet("samples")) {
+        nSamples = parser.value("samples").toInt();
+    }
+    if (parser.isSet("radius")) {
+        sampleRadius = parser.value("radius").toFloat();
+    }
+    if (parser.isSet("indirect-downsample")) {
+        indirectDownsample = parser.value("indirect-downsample").toInt();
+    }
+    if (parser.isSet("temporal")) {
+        temporal = true;
+    }
+    if (parser.isSet("rsm-hierarchy")) {
+        rsmHierarchy = true;
+    }
+    if (parser.isSet("vpls")) {
+        vplCount = parser.value("vpls").toInt();
+    }
+    if (parser.isSet("vertex-layout")) {
+        vertexLayout = vertexLayoutFromString(parser.value("vertex-layout"), vertexLayout);
+    }
+    if (parser.isSet("optimize-mesh")) {
+        optimizeMesh = true;
+    }
+    if (parser.isSet("no-cluster-culling")) {
+        clusterCulling = false;
+    }
+    if (parser.isSet("deferred")) {
+        deferred = true;
+    }
+    if (parser.isSet("scene")) {
+        scene = parser.value("scene");
+    }
+
+    validate();
+}
+
+void RenderSettings::validate() {
+    shadowMapSize = std::min(std::max(shadowMapSize, 64), 4096);
+    nSamples = std::min(std::max(nSamples, 1), 1024);
+    sampleRadius = std::min(std::max(sampleRadius, 0.001f), 1.0f);
+    indirectDownsample = indirectDownsample >= 4 ? 4 : (indirectDownsample >= 2 ? 2 : 1);
+
+    // VPLs fill whole rows of the ISM atlas
+    vplCount = std::min(std::max(vplCount, ISM_COLS), 32 * ISM_COLS);
+    vplCount = (vplCount / ISM_COLS) * ISM_COLS;
+}
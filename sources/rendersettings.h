@@ -0,0 +1,68 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _RENDER_SETTINGS_H_
+#define _RENDER_SETTINGS_H_
+
+#include <QtCore/qstring.h>
+
+#include "rsmformat.h"
+#include "vertexformat.h"
+
+class QCommandLineParser;
+
+// Virtual point lights per row of the ISM atlas
+static const int ISM_COLS = 32;
+
+enum class ShadowMapType : int {
+    SM = 0x01,
+    RSM = 0x02,
+    ISM = 0x04
+};
+
+// Where the six cube faces of the light are stored.
+//   Atlas:   one 2D texture holding a 4x3 cross, written by the geometry
+//            shader offsetting each face into its cell.
+//   Layered: a 6-layer 2D array bound as a layered attachment. The
+//            geometry shader routes triangles with gl_Layer and drops the
+//            faces they cannot touch.
+enum class ShadowMapLayout : int {
+    Atlas = 0x01,
+    Layered = 0x02
+};
+
+// Quality and performance knobs that can change without a rebuild. The
+// defaults match the values that used to be compiled in.
+struct RenderSettings {
+    ShadowMapType mode = ShadowMapType::RSM;
+    ShadowMapLayout layout = ShadowMapLayout::Atlas;
+    RsmFormat rsmFormat = RsmFormat::Compact;
+    int shadowMapSize = 512;    // texels per cube face
+    int nSamples = 64;          // RSM gather samples per pixel
+    float sampleRadius = 0.5f;  // RSM gather radius in atlas coordinates
+    int indirectDownsample = 1; // RSM indirect light at 1/1, 1/2 or 1/4 resolution
+    bool temporal = false;      // accumulate the RSM indirect light over frames
+    bool rsmHierarchy = false;  // gather distant samples from a flux-weighted mip chain
+    int vplCount = 256;         // ISM virtual point lights, multiple of 32
+    VertexLayout vertexLayout = VertexLayout::Float;
+    bool optimizeMesh = false;  // vertex cache / overdraw reordering on load
+    bool clusterCulling = true; // skip clusters outside the view or facing away
+    bool deferred = false;      // G-buffer and full-screen lighting passes
+    QString scene;              // scene file or .ply; empty loads cbox.ply
+
+    // Loads the keys present in an INI file; others keep their value.
+    bool load(const QString &filename);
+
+    // --config, --mode, --layout, --rsm-format, --shadow-size, --samples,
+    // --radius, --indirect-downsample, --temporal, --rsm-hierarchy, --vpls, --vertex-layout,
+    // --optimize-mesh, --no-cluster-culling, --deferred and --scene. A config file is read before the
+    // other options.
+    static void addOptions(QCommandLineParser &parser);
+    void parse(const QCommandLineParser &parser);
+
+    // Keeps every value in the range the renderer supports
+    void validate();
+};
+
+#endif  // _RENDER_SETTINGS_H_
@@ -0,0 +1,204 @@
+#include "rendertarget.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "glutils.h"
+
+namespace {
+
+struct FormatInfo {
+    int bytesPerTexel;
+    GLenum format;
+    GLenum type;
+};
+
+FormatInfo formatInfo(GLenum internalFormat) {
+    switch (internalFormat) {
+    case GL_DEPTH_COMPONENT16:  return { 2, GL_DEPTH_COMPONENT, GL_FLOAT };
+    case GL_DEPTH_COMPONENT24:  return { 4, GL_DEPTH_COMPONENT, GL_FLOAT };
+    case GL_DEPTH_COMPONENT32F: return { 4, GL_DEPTH_COMPONENT, GL_FLOAT };
+    case GL_R8:                 return { 1, GL_RED,  GL_UNSIGNED_BYTE };
+    case GL_R16F:               return { 2, GL_RED,  GL_FLOAT };
+    case GL_R32F:               return { 4, GL_RED,  GL_FLOAT };
+    case GL_RG8:                return { 2, GL_RG,   GL_UNSIGNED_BYTE };
+    case GL_RG16:               return { 4, GL_RG,   GL_UNSIGNED_SHORT };
+    case GL_RG16_SNORM:         return { 4, GL_RG,   GL_SHORT };
+    case GL_RG16F:              return { 4, GL_RG,   GL_FLOAT };
+    case GL_RG32F:              return { 8, GL_RG,   GL_FLOAT };
+    case GL_RGBA8:              return { 4, GL_RGBA, GL_UNSIGNED_BYTE };
+    case GL_RGB10_A2:           return { 4, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV };
+    case GL_RGBA16F:            return { 8, GL_RGBA, GL_FLOAT };
+    case GL_RGBA32F:            return { 16, GL_RGBA, GL_FLOAT };
+    default:
+        std::cerr << "[ERROR] unsupported render target format: " << internalFormat << std::endl;
+        return { 4, GL_RGBA, GL_UNSIGNED_BYTE };
+    }
+}
+
+}  // anonymous namespace
+
+// --
+// RenderTargetPool
+// --
+
+RenderTargetPool::RenderTargetPool() {
+}
+
+RenderTargetPool::~RenderTargetPool() {
+    clear();
+}
+
+std::shared_ptr<RenderTarget> RenderTargetPool::acquire(const RenderTargetDesc &desc) {
+    for (const auto &t : targets_) {
+        if (t.use_count() == 1 && t->desc() == desc) {
+            stats_.reuses++;
+            return t;
+        }
+    }
+
+    auto f = glCoreFunctions();
+    const FormatInfo info = formatInfo(desc.internalFormat);
+    const int faces = desc.target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+    size_t bytes = 0;
+    for (int level = 0; level < desc.levels; level++) {
+        bytes += (size_t)std::max(desc.width >> level, 1) * std::max(desc.height >> level, 1) *
+                 desc.layers * faces * info.bytesPerTexel;
+    }
+
+    GLuint id = 0;
+    f->glGenTextures(1, &id);
+    f->glBindTexture(desc.target, id);
+    switch (desc.target) {
+    case GL_TEXTURE_2D:
+        for (int level = 0; level < desc.levels; level++) {
+            f->glTexImage2D(GL_TEXTURE_2D, level, desc.internalFormat,
+                            std::max(desc.width >> level, 1), std::max(desc.height >> level, 1), 0,
+                            info.format, info.type, nullptr);
+        }
+        break;
+
+    case GL_TEXTURE_2D_ARRAY:
+        f->glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, desc.internalFormat, desc.width, desc.height, desc.layers, 0,
+                        info.format, info.type, nullptr);
+        break;
+
+    case GL_TEXTURE_CUBE_MAP:
+        for (int i = 0; i < 6; i++) {
+            f->glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, desc.internalFormat, desc.width, desc.height, 0,
+                            info.format, info.type, nullptr);
+        }
+        break;
+    }
+    f->glTexParameteri(desc.target, GL_TEXTURE_MIN_FILTER, desc.levels > 1 ? GL_NEAREST_MIPMAP_NEAREST : GL_NEAREST);
+    f->glTexParameteri(desc.target, GL_TEXTURE_MAX_LEVEL, desc.levels - 1);
+    f->glTexParameteri(desc.target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    f->glTexParameteri(desc.target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    f->glTexParameteri(desc.target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    f->glTexParameteri(desc.target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    f->glBindTexture(desc.target, 0);
+
+    auto target = std::make_shared<RenderTarget>(id, desc, bytes);
+    targets_.push_back(target);
+
+    stats_.allocations++;
+    stats_.bytes += bytes;
+    stats_.peakBytes = std::max(stats_.peakBytes, stats_.bytes);
+
+    return target;
+}
+
+void RenderTargetPool::trim() {
+    auto it = targets_.begin();
+    while (it != targets_.end()) {
+        if (it->use_count() == 1) {
+            const GLuint id = (*it)->textureId();
+            glCoreFunctions()->glDeleteTextures(1, &id);
+            stats_.frees++;
+            stats_.bytes -= (*it)->bytes();
+            it = targets_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void RenderTargetPool::clear() {
+    if (targets_.empty()) return;
+
+    auto f = glCoreFunctions();
+    for (const auto &t : targets_) {
+        const GLuint id = t->textureId();
+        f->glDeleteTextures(1, &id);
+        stats_.frees++;
+    }
+    targets_.clear();
+    stats_.bytes = 0;
+}
+
+// --
+// Framebuffer
+// --
+
+Framebuffer::Framebuffer(int width, int height)
+    : width_(width)
+    , height_(height) {
+    glCoreFunctions()->glGenFramebuffers(1, &fbo_);
+}
+
+Framebuffer::~Framebuffer() {
+    if (fbo_) {
+        glCoreFunctions()->glDeleteFramebuffers(1, &fbo_);
+        fbo_ = 0;
+    }
+}
+
+void Framebuffer::attach(GLenum attachment, const RenderTarget &target, int level) {
+    auto f = glCoreFunctions();
+    GLint prevFbo = 0;
+    f->glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prevFbo);
+    f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_);
+    if (target.desc().target == GL_TEXTURE_2D) {
+        f->glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, attachment, GL_TEXTURE_2D, target.textureId(), level);
+    } else {
+        // Layered attachment: every face / layer is selected with gl_Layer.
+        f->glFramebufferTexture(GL_DRAW_FRAMEBUFFER, attachment, target.textureId(), level);
+    }
+    f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, prevFbo);
+}
+
+void Framebuffer::setDrawBuffers(int count) {
+    static const GLenum bufs[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1,
+                                   GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3,
+                                   GL_COLOR_ATTACHMENT4, GL_COLOR_ATTACHMENT5,
+                                   GL_COLOR_ATTACHMENT6, GL_COLOR_ATTACHMENT7 };
+    auto f = glCoreFunctions();
+    GLint prevFbo = 0;
+    f->glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prevFbo);
+    f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_);
+    if (count == 0) {
+        f->glDrawBuffer(GL_NONE);
+    } else {
+        f->glDrawBuffers(count, bufs);
+    }
+    f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, prevFbo);
+}
+
+bool Framebuffer::isComplete() {
+    auto f = glCoreFunctions();
+    GLint prevFbo = 0;
+    f->glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prevFbo);
+    f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_);
+    const GLenum status = f->glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+    f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, prevFbo);
+    return status == GL_FRAMEBUFFER_COMPLETE;
+}
+
+void Framebuffer::bind() {
+    glCoreFunctions()->glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+}
+
+void Framebuffer::release() {
+    const GLuint defaultFbo = QOpenGLContext::currentContext()->defaultFramebufferObject();
+    glCoreFunctions()->glBindFramebuffer(GL_FRAMEBUFFER, defaultFbo);
+}
@@ -0,0 +1,112 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _RENDER_TARGET_H_
+#define _RENDER_TARGET_H_
+
+#include <memory>
+#include <vector>
+
+#include <QtGui/qopenglfunctions_3_3_core.h>
+
+struct RenderTargetDesc {
+    GLenum target;
+    int width;
+    int height;
+    int layers;
+    GLenum internalFormat;
+    int levels;
+
+    bool operator==(const RenderTargetDesc &other) const {
+        return target == other.target && width == other.width &&
+               height == other.height && layers == other.layers &&
+               internalFormat == other.internalFormat && levels == other.levels;
+    }
+
+    static RenderTargetDesc texture2D(int width, int height, GLenum internalFormat) {
+        return { GL_TEXTURE_2D, width, height, 1, internalFormat, 1 };
+    }
+
+    static RenderTargetDesc texture2DArray(int width, int height, int layers, GLenum internalFormat) {
+        return { GL_TEXTURE_2D_ARRAY, width, height, layers, internalFormat, 1 };
+    }
+
+    // Mip levels are sampled with nearest filtering and written one at a
+    // time through Framebuffer::attach()
+    static RenderTargetDesc texture2DMipmapped(int width, int height, int levels, GLenum internalFormat) {
+        return { GL_TEXTURE_2D, width, height, 1, internalFormat, levels };
+    }
+};
+
+// Texture used as a render target. Owned by RenderTargetPool.
+class RenderTarget {
+public:
+    RenderTarget(GLuint id, const RenderTargetDesc &desc, size_t bytes)
+        : id_(id)
+        , desc_(desc)
+        , bytes_(bytes) {
+    }
+
+    inline GLuint textureId() const { return id_; }
+    inline const RenderTargetDesc &desc() const { return desc_; }
+    inline size_t bytes() const { return bytes_; }
+
+private:
+    GLuint id_;
+    RenderTargetDesc desc_;
+    size_t bytes_;
+};
+
+// Render targets keyed by size and format. A target is free again once
+// nobody but the pool holds it, and the next acquire() with a matching
+// description reuses it instead of reallocating.
+class RenderTargetPool {
+public:
+    struct Stats {
+        int allocations = 0;
+        int reuses = 0;
+        int frees = 0;
+        size_t bytes = 0;
+        size_t peakBytes = 0;
+    };
+
+    explicit RenderTargetPool();
+    virtual ~RenderTargetPool();
+
+    std::shared_ptr<RenderTarget> acquire(const RenderTargetDesc &desc);
+    void trim();
+    void clear();
+
+    inline const Stats &stats() const { return stats_; }
+    int liveCount() const { return (int)targets_.size(); }
+
+private:
+    std::vector<std::shared_ptr<RenderTarget>> targets_;
+    Stats stats_;
+};
+
+// Thin framebuffer object whose attachments come from RenderTargetPool.
+class Framebuffer {
+public:
+    explicit Framebuffer(int width, int height);
+    virtual ~Framebuffer();
+
+    void attach(GLenum attachment, const RenderTarget &target, int level = 0);
+    void setDrawBuffers(int count);
+    bool isComplete();
+
+    void bind();
+    void release();
+
+    inline GLuint handle() const { return fbo_; }
+    inline int width() const { return width_; }
+    inline int height() const { return height_; }
+
+private:
+    GLuint fbo_ = 0;
+    int width_;
+    int height_;
+};
+
+#endif  // _RENDER_TARGET_H_
@@ -0,0 +1,57 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _RSM_FORMAT_H_
+#define _RSM_FORMAT_H_
+
+#include <string>
+#include <vector>
+
+#include <QtGui/qopenglfunctions_3_3_core.h>
+
+// Storage layout of the reflective shadow map.
+//   Full:    depth, world position, normal and albedo as four RGBA32F
+//            targets (64 bytes per texel).
+//   Compact: a 32-bit depth texture, octahedral RG16 normals and RGBA8
+//            albedo (12 bytes per texel). World position is reconstructed
+//            from depth in the shader.
+enum class RsmFormat : int {
+    Full = 0x01,
+    Compact = 0x02
+};
+
+struct RsmAttachment {
+    std::string name;       // debug dump name, empty if not dumped
+    std::string sampler;    // sampler uniform in render.fs, empty if not sampled
+    GLenum attachment;
+    GLenum internalFormat;
+    GLenum pixelFormat;     // transfer format for readback
+};
+
+inline std::vector<RsmAttachment> rsmAttachments(RsmFormat format) {
+    if (format == RsmFormat::Compact) {
+        return {
+            { "depth",    "u_depthMap",    GL_DEPTH_ATTACHMENT,  GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT },
+            { "normal",   "u_normalMap",   GL_COLOR_ATTACHMENT0, GL_RG16,               GL_RG },
+            { "diffuse",  "u_diffuseMap",  GL_COLOR_ATTACHMENT1, GL_RGBA8,              GL_RGBA }
+        };
+    }
+
+    return {
+        { "",         "",              GL_DEPTH_ATTACHMENT,  GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT },
+        { "depth",    "u_depthMap",    GL_COLOR_ATTACHMENT0, GL_RGBA32F,           GL_RGBA },
+        { "position", "u_positionMap", GL_COLOR_ATTACHMENT1, GL_RGBA32F,           GL_RGBA },
+        { "normal",   "u_normalMap",   GL_COLOR_ATTACHMENT2, GL_RGBA32F,           GL_RGBA },
+        { "diffuse",  "u_diffuseMap",  GL_COLOR_ATTACHMENT3, GL_RGBA32F,           GL_RGBA }
+    };
+}
+
+inline std::vector<std::string> rsmShaderDefines(RsmFormat format) {
+    if (format == RsmFormat::Compact) {
+        return { "RSM_COMPACT" };
+    }
+    return {};
+}
+
+#endif  // _RSM_FORMAT_H_
@@ -0,0 +1,602 @@
+#include "rsmtechnique.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "common.h"
+#include "glutils.h"
+
+namespace {
+
+// Frames blended into the temporal history at most
+const float TEMPORAL_MAX_HISTORY = 16.0f;
+
+// Size of the RsmKernel block in rsmgather.glsl. 1024 vec4s are 16 KiB,
+// the smallest GL_MAX_UNIFORM_BLOCK_SIZE an implementation may have.
+const int RSM_MAX_SAMPLES = 1024;
+const GLuint RSM_KERNEL_BINDING = 0;
+
+// Coarsest gather level: faces are not halved below this many texels
+const int RSM_MIP_MIN_FACE = 8;
+const int RSM_MIP_MAX_LEVELS = 5;
+
+const float Pi = 3.14159265358979f;
+
+float radicalInverse(int base, int i) {
+    const float inv = 1.0f / base;
+    float f = inv;
+    float r = 0.0f;
+    while (i > 0) {
+        r += f * (i % base);
+        i /= base;
+        f *= inv;
+    }
+    return r;
+}
+
+// Levels of the gather hierarchy for a face size; each halves the face
+int hierarchyLevels(int faceSize) {
+    int levels = 0;
+    while (levels < RSM_MIP_MAX_LEVELS && faceSize % 2 == 0 && faceSize / 2 >= RSM_MIP_MIN_FACE) {
+        faceSize /= 2;
+        levels++;
+    }
+    return levels;
+}
+
+}  // anonymous namespace
+
+void RsmTechnique::initialize(const RenderContext &ctx) {
+    initializeOpenGLFunctions();
+
+    rsmFormat = ctx.settings.rsmFormat;
+    layout = ctx.settings.layout;
+    indirectDownsample = ctx.settings.indirectDownsample;
+    deferred = ctx.settings.deferred;
+    temporal = ctx.settings.temporal;
+    hierarchy = ctx.settings.rsmHierarchy;
+    compileShaders();
+    createTargets(ctx);
+    createKernel(ctx.settings.nSamples, ctx.settings.sampleRadius, ctx.settings.shadowMapSize,
+                 hierarchy ? hierarchyLevels(ctx.settings.shadowMapSize) : 0);
+}
+
+void RsmTechnique::release() {
+    rsmShader.reset();
+    shader.reset();
+    indirectShader.reset();
+    temporalShader.reset();
+    mipBaseShader.reset();
+    mipShader.reset();
+    rsmFbo.reset();
+    rsmTargets.clear();
+    rsmLayout.clear();
+    releaseIndirectTargets();
+    indirectDownsample = 1;
+    deferred = false;
+    temporal = false;
+    releaseMipTargets();
+    hierarchy = false;
+    releaseGBuffer();
+    if (kernelBuffer) {
+        glDeleteBuffers(1, &kernelBuffer);
+        kernelBuffer = 0;
+    }
+    kernelSamples = 0;
+    kernelRadius = 0.0f;
+    kernelFaceSize = 0;
+    kernelLevels = 0;
+    casterQuery.release();
+}
+
+void RsmTechnique::compileShaders() {
+    const auto defines = shaderDefines();
+    rsmShader = compileShader(std::string(SOURCE_DIRECTORY) + "shaders/rsm", true, defines);
+    compileSceneShaders();
+}
+
+// Variants for the shading path and for whether the gather is split off
+void RsmTechnique::compileSceneShaders() {
+    auto defines = shaderDefines();
+    if (hierarchy) {
+        auto baseDefines = defines;
+        baseDefines.push_back("RSM_MIP_BASE");
+        mipBaseShader = compileShader(std::string(SOURCE_DIRECTORY) + "shaders/rsmmip", false, baseDefines);
+        mipShader = compileShader(std::string(SOURCE_DIRECTORY) + "shaders/rsmmip");
+        defines.push_back("RSM_HIERARCHY");
+    } else {
+        mipBaseShader.reset();
+        mipShader.reset();
+    }
+    if (splitIndirect()) {
+        auto indirectDefines = defines;
+        if (deferred) {
+            indirectDefines.push_back("DEFERRED");
+        }
+        indirectShader = compileShader(std::string(SOURCE_DIRECTORY) + "shaders/indirect", false, indirectDefines);
+        defines.push_back("INDIRECT_UPSAMPLE");
+    } else {
+        indirectShader.reset();
+    }
+    if (temporal) {
+        temporalShader = compileShader(std::string(SOURCE_DIRECTORY) + "shaders/temporal");
+    } else {
+        temporalShader.reset();
+    }
+    shader = compileShader(std::string(SOURCE_DIRECTORY) + (deferred ? "shaders/deferred" : "shaders/render"),
+                           false, defines);
+}
+
+void RsmTechnique::createTargets(const RenderContext &ctx) {
+    // Drop the old layout first so that matching targets can be reused
+    rsmFbo.reset();
+    rsmTargets.clear();
+
+    shadowMapSize = ctx.settings.shadowMapSize;
+    rsmLayout = rsmAttachments(rsmFormat);
+    const RenderTargetDesc desc = shadowMapDesc(ctx, GL_RGBA8);
+    rsmFbo = std::make_unique<Framebuffer>(desc.width, desc.height);
+    int nColors = 0;
+    for (const auto &att : rsmLayout) {
+        rsmTargets.push_back(ctx.targetPool->acquire(shadowMapDesc(ctx, att.internalFormat)));
+        rsmFbo->attach(att.attachment, *rsmTargets.back());
+        if (att.attachment != GL_DEPTH_ATTACHMENT) {
+            nColors++;
+        }
+    }
+    rsmFbo->setDrawBuffers(nColors);
+    if (!rsmFbo->isComplete()) {
+        std::cerr << "[ERROR] RSM framebuffer is incomplete" << std::endl;
+    }
+
+    ctx.targetPool->trim();
+}
+
+void RsmTechnique::createIndirectTargets(const RenderContext &ctx, int width, int height) {
+    releaseIndirectTargets();
+
+    indirectTargets = {
+        ctx.targetPool->acquire(RenderTargetDesc::texture2D(width, height, GL_DEPTH_COMPONENT24)),
+        ctx.targetPool->acquire(RenderTargetDesc::texture2D(width, height, GL_RGBA16F)),
+        ctx.targetPool->acquire(RenderTargetDesc::texture2D(width, height, GL_RGBA16F))
+    };
+    indirectFbo = std::make_unique<Framebuffer>(width, height);
+    indirectFbo->attach(GL_DEPTH_ATTACHMENT, *indirectTargets[0]);
+    indirectFbo->attach(GL_COLOR_ATTACHMENT0, *indirectTargets[1]);
+    indirectFbo->attach(GL_COLOR_ATTACHMENT1, *indirectTargets[2]);
+    indirectFbo->setDrawBuffers(2);
+    if (!indirectFbo->isComplete()) {
+        std::cerr << "[ERROR] indirect light framebuffer is incomplete" << std::endl;
+    }
+
+    if (temporal) {
+        prevGeometry = ctx.targetPool->acquire(RenderTargetDesc::texture2D(width, height, GL_RGBA16F));
+        for (int i = 0; i < 2; i++) {
+            historyTargets[i] = ctx.targetPool->acquire(RenderTargetDesc::texture2D(width, height, GL_RGBA16F));
+            historyFbo[i] = std::make_unique<Framebuffer>(width, height);
+            historyFbo[i]->attach(GL_COLOR_ATTACHMENT0, *historyTargets[i]);
+            historyFbo[i]->setDrawBuffers(1);
+        }
+        if (!historyFbo[0]->isComplete() || !historyFbo[1]->isComplete()) {
+            std::cerr << "[ERROR] temporal history framebuffer is incomplete" << std::endl;
+        }
+    }
+    historyValid = false;
+
+    ctx.targetPool->trim();
+}
+
+void RsmTechnique::releaseIndirectTargets() {
+    indirectFbo.reset();
+    indirectTargets.clear();
+    for (int i = 0; i < 2; i++) {
+        historyFbo[i].reset();
+        historyTargets[i].reset();
+    }
+    prevGeometry.reset();
+    historyValid = false;
+}
+
+// The pyramid keeps the 4x3 atlas arrangement whatever the RSM layout, so
+// that a gather coordinate addresses every level alike
+void RsmTechnique::createMipTargets(const RenderContext &ctx, int levels) {
+    releaseMipTargets();
+
+    const int width = 4 * shadowMapSize / 2;
+    const int height = 3 * shadowMapSize / 2;
+    for (int i = 0; i < 3; i++) {
+        mipTargets.push_back(ctx.targetPool->acquire(
+            RenderTargetDesc::texture2DMipmapped(width, height, levels, GL_RGBA16F)));
+    }
+    for (int level = 0; level < levels; level++) {
+        mipFbos.push_back(std::make_unique<Framebuffer>(width >> level, height >> level));
+        for (int i = 0; i < 3; i++) {
+            mipFbos.back()->attach(GL_COLOR_ATTACHMENT0 + i, *mipTargets[i], level);
+        }
+        mipFbos.back()->setDrawBuffers(3);
+        if (!mipFbos.back()->isComplete()) {
+            std::cerr << "[ERROR] RSM mip framebuffer is incomplete" << std::endl;
+        }
+    }
+
+    ctx.targetPool->trim();
+}
+
+void RsmTechnique::releaseMipTargets() {
+    mipFbos.clear();
+    mipTargets.clear();
+}
+
+// Halton points on the disc with the radius linear in the first
+// coordinate, so that samples crowd towards the center where the nearby
+// pixel lights contribute most. The weights undo that density, and are
+// normalized to a mean of one so the sum still estimates the disc mean.
+//
+// With a hierarchy of the given number of levels each sample also gets the
+// level whose texels are about as large as the spacing of the samples
+// around it, so the sparse outer samples read the flux of their whole
+// neighbourhood rather than of a single texel.
+void RsmTechnique::createKernel(int nSamples, float radius, int faceSize, int levels) {
+    nSamples = std::min(nSamples, RSM_MAX_SAMPLES);
+
+    // std140 pads vec2 array elements to 16 bytes anyway; the weight
+    // takes the third component
+    std::vector<float> kernel(RSM_MAX_SAMPLES * 4, 0.0f);
+    float weightSum = 0.0f;
+    for (int i = 0; i < nSamples; i++) {
+        const float u1 = radicalInverse(2, i + 1);
+        const float u2 = radicalInverse(3, i + 1);
+        kernel[i * 4 + 0] = radius * u1 * std::cos(2.0f * Pi * u2);
+        kernel[i * 4 + 1] = radius * u1 * std::sin(2.0f * Pi * u2);
+        kernel[i * 4 + 2] = u1;
+        weightSum += u1;
+
+        // n samples over the disc area, at density 1 / (2 pi r R) along r
+        const float spacing = std::sqrt(2.0f * Pi * radius * radius * u1 / nSamples);
+        const float texel = 1.0f / (3.0f * faceSize);
+        if (levels > 0 && spacing > texel) {
+            const float lod = std::round(std::log2(spacing / texel));
+            kernel[i * 4 + 3] = std::min(lod, (float)levels);
+        }
+    }
+    for (int i = 0; i < nSamples; i++) {
+        kernel[i * 4 + 2] *= nSamples / weightSum;
+    }
+
+    // The whole block is always backed, whatever the sample count
+    if (!kernelBuffer) {
+        glGenBuffers(1, &kernelBuffer);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, kernelBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, kernel.size() * sizeof(float), kernel.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    kernelSamples = nSamples;
+    kernelRadius = radius;
+    kernelFaceSize = faceSize;
+    kernelLevels = levels;
+}
+
+bool RsmTechnique::update(const RenderContext &ctx) {
+    const RenderSettings &settings = ctx.settings;
+    const int levels = settings.rsmHierarchy ? hierarchyLevels(settings.shadowMapSize) : 0;
+    if (settings.nSamples != kernelSamples || settings.sampleRadius != kernelRadius ||
+        settings.shadowMapSize != kernelFaceSize || levels != kernelLevels) {
+        createKernel(settings.nSamples, settings.sampleRadius, settings.shadowMapSize, levels);
+        historyValid = false;
+    }
+
+    const bool definesChanged = rsmFormat != settings.rsmFormat || layout != settings.layout;
+    if (definesChanged) {
+        rsmFormat = settings.rsmFormat;
+        layout = settings.layout;
+        compileShaders();
+    }
+    if (definesChanged || shadowMapSize != settings.shadowMapSize) {
+        createTargets(ctx);
+        historyValid = false;
+    }
+    return definesChanged;
+}
+
+std::vector<std::string> RsmTechnique::shaderDefines() const {
+    auto defines = rsmShaderDefines(rsmFormat);
+    for (const auto &d : layoutShaderDefines(layout)) {
+        defines.push_back(d);
+    }
+    return defines;
+}
+
+void RsmTechnique::render(const RenderContext &ctx) {
+    update(ctx);
+
+    const RenderSettings &settings = ctx.settings;
+    if (settings.indirectDownsample != indirectDownsample || settings.deferred != deferred ||
+        settings.temporal != temporal || settings.rsmHierarchy != hierarchy) {
+        const bool wasSplit = splitIndirect();
+        const bool temporalChanged = settings.temporal != temporal;
+        const bool deferredChanged = settings.deferred != deferred;
+        const bool hierarchyChanged = settings.rsmHierarchy != hierarchy;
+        indirectDownsample = settings.indirectDownsample;
+        deferred = settings.deferred;
+        temporal = settings.temporal;
+        hierarchy = settings.rsmHierarchy;
+        if (temporalChanged) {
+            releaseIndirectTargets();
+        }
+        if (temporalChanged || deferredChanged || hierarchyChanged || wasSplit != splitIndirect()) {
+            compileSceneShaders();
+        }
+        if (hierarchyChanged) {
+            historyValid = false;
+        }
+
+        // Averages mixing both configurations would hide the difference
+        ctx.profiler->clearHistory();
+    }
+    if (!splitIndirect() && indirectFbo) {
+        releaseIndirectTargets();
+        ctx.targetPool->trim();
+    }
+    if (kernelLevels == 0 && !mipTargets.empty()) {
+        releaseMipTargets();
+        ctx.targetPool->trim();
+    } else if (kernelLevels > 0 && (mipTargets.empty() ||
+               mipTargets[0]->desc().width != 2 * shadowMapSize ||
+               mipTargets[0]->desc().levels != kernelLevels)) {
+        createMipTargets(ctx, kernelLevels);
+    }
+    frameIndex++;
+
+    renderShadowMap(ctx);
+    if (!mipFbos.empty()) {
+        renderHierarchy(ctx);
+    }
+    updateGBuffer(ctx);
+    if (splitIndirect()) {
+        renderIndirect(ctx);
+    }
+
+    ctx.profiler->beginPass(deferred ? "lighting" : "scene");
+    glViewport(ctx.viewport[0], ctx.viewport[1], ctx.viewport[2], ctx.viewport[3]);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    shader->bind();
+    bindTextures(*shader);
+    setSceneUniforms(*shader, ctx);
+    if (splitIndirect()) {
+        const RenderTarget &indirect = temporal ? *historyTargets[historyIndex] : *indirectTargets[1];
+        glActiveTexture(GL_TEXTURE11);
+        glBindTexture(GL_TEXTURE_2D, indirect.textureId());
+        shader->setUniformValue("u_indirectMap", 11);
+        glActiveTexture(GL_TEXTURE12);
+        glBindTexture(GL_TEXTURE_2D, indirectTargets[2]->textureId());
+        shader->setUniformValue("u_indirectGeometry", 12);
+        shader->setUniformValue("u_indirectRatio", indirectRatio(ctx));
+    } else {
+        setGatherUniforms(*shader);
+    }
+
+    if (deferred) {
+        drawDeferred(ctx, *shader);
+    } else {
+        drawScene(ctx, *shader);
+    }
+    shader->release();
+}
+
+void RsmTechnique::setGatherUniforms(QOpenGLShaderProgram &program) {
+    const GLuint block = glGetUniformBlockIndex(program.programId(), "RsmKernel");
+    if (block != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program.programId(), block, RSM_KERNEL_BINDING);
+    }
+    glBindBufferBase(GL_UNIFORM_BUFFER, RSM_KERNEL_BINDING, kernelBuffer);
+    program.setUniformValue("u_nSamples", kernelSamples);
+
+    // Temporal mode turns the kernel by a new angle every frame
+    float angle = 0.0f;
+    if (temporal) {
+        angle = 2.0f * Pi * radicalInverse(2, frameIndex % 64 + 1);
+    }
+    const float rotation[4] = { std::cos(angle), -std::sin(angle), std::sin(angle), std::cos(angle) };
+    program.setUniformValue("u_sampleRotation", QMatrix2x2(rotation));
+
+    if (!mipTargets.empty()) {
+        static const char *samplers[3] = { "u_mipPosition", "u_mipNormal", "u_mipFlux" };
+        for (int i = 0; i < 3; i++) {
+            glActiveTexture(GL_TEXTURE5 + i);
+            glBindTexture(GL_TEXTURE_2D, mipTargets[i]->textureId());
+            program.setUniformValue(samplers[i], 5 + i);
+        }
+    }
+}
+
+void RsmTechnique::renderHierarchy(const RenderContext &ctx) {
+    ctx.profiler->beginPass("rsm mips");
+    glDisable(GL_DEPTH_TEST);
+
+    // The first level reads the RSM in whatever layout it is stored
+    mipFbos[0]->bind();
+    glViewport(0, 0, mipFbos[0]->width(), mipFbos[0]->height());
+    mipBaseShader->bind();
+    bindTextures(*mipBaseShader);
+    setSceneUniforms(*mipBaseShader, ctx);
+    mipBaseShader->setUniformValue("u_rsmSize", QVector2D(4.0f * shadowMapSize, 3.0f * shadowMapSize));
+    drawFullScreen(ctx);
+    mipBaseShader->release();
+
+    // Further levels read the one below, which is the only level the
+    // textures expose meanwhile so that none is read and written at once
+    mipShader->bind();
+    static const char *samplers[3] = { "u_mipPosition", "u_mipNormal", "u_mipFlux" };
+    for (int i = 0; i < 3; i++) {
+        glActiveTexture(GL_TEXTURE5 + i);
+        glBindTexture(GL_TEXTURE_2D, mipTargets[i]->textureId());
+        mipShader->setUniformValue(samplers[i], 5 + i);
+    }
+    const int levels = (int)mipFbos.size();
+    for (int level = 1; level < levels; level++) {
+        for (int i = 0; i < 3; i++) {
+            glActiveTexture(GL_TEXTURE5 + i);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+        }
+        mipFbos[level]->bind();
+        glViewport(0, 0, mipFbos[level]->width(), mipFbos[level]->height());
+        drawFullScreen(ctx);
+    }
+    for (int i = 0; i < 3; i++) {
+        glActiveTexture(GL_TEXTURE5 + i);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    }
+    mipShader->release();
+    mipFbos[0]->release();
+
+    glEnable(GL_DEPTH_TEST);
+}
+
+void RsmTechnique::renderIndirect(const RenderContext &ctx) {
+    // Rounded up so that the low-resolution texels cover the whole window
+    const int downsample = ctx.settings.indirectDownsample;
+    const int width = (ctx.viewport[2] + downsample - 1) / downsample;
+    const int height = (ctx.viewport[3] + downsample - 1) / downsample;
+    if (!indirectFbo || indirectFbo->width() != width || indirectFbo->height() != height) {
+        createIndirectTargets(ctx, width, height);
+    }
+
+    // The geometry of the last frame moves to the history
+    if (temporal) {
+        std::swap(indirectTargets[2], prevGeometry);
+        indirectFbo->attach(GL_COLOR_ATTACHMENT1, *indirectTargets[2]);
+    }
+
+    ctx.profiler->beginPass("indirect");
+    glViewport(0, 0, width, height);
+    indirectFbo->bind();
+
+    // Zero depth in the geometry target marks texels without a surface
+    float zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    glClearBufferfv(GL_COLOR, 0, zero);
+    glClearBufferfv(GL_COLOR, 1, zero);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    indirectShader->bind();
+    bindTextures(*indirectShader);
+    setSceneUniforms(*indirectShader, ctx);
+    setGatherUniforms(*indirectShader);
+    if (deferred) {
+        indirectShader->setUniformValue("u_indirectRatio", indirectRatio(ctx));
+        drawDeferred(ctx, *indirectShader);
+    } else {
+        drawScene(ctx, *indirectShader);
+    }
+    indirectShader->release();
+    indirectFbo->release();
+
+    if (temporal) {
+        resolveTemporal(ctx);
+    }
+}
+
+void RsmTechnique::resolveTemporal(const RenderContext &ctx) {
+    const QMatrix4x4 vpMat = ctx.camera->mvpMat();
+    const QMatrix4x4 mvMat = ctx.camera->mvMat();
+
+    // Reprojection keeps the history through camera motion, but the
+    // image only converges once the view rests
+    if (!historyValid || vpMat != prevVpMat) {
+        stillFrames = 0;
+    }
+
+    ctx.profiler->beginPass("temporal");
+    const int src = historyIndex;
+    const int dst = 1 - src;
+    historyFbo[dst]->bind();
+
+    temporalShader->bind();
+    const GLuint textures[4] = {
+        indirectTargets[1]->textureId(), indirectTargets[2]->textureId(),
+        historyTargets[src]->textureId(), prevGeometry->textureId()
+    };
+    static const char *samplers[4] = {
+        "u_indirectMap", "u_indirectGeometry", "u_historyMap", "u_historyGeometry"
+    };
+    for (int i = 0; i < 4; i++) {
+        glActiveTexture(GL_TEXTURE11 + i);
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        temporalShader->setUniformValue(samplers[i], 11 + i);
+    }
+    temporalShader->setUniformValue("u_invVpMat", vpMat.inverted());
+    temporalShader->setUniformValue("u_mvMat", mvMat);
+    temporalShader->setUniformValue("u_prevVpMat", prevVpMat);
+    temporalShader->setUniformValue("u_prevMvMat", prevMvMat);
+    temporalShader->setUniformValue("u_historyValid", historyValid);
+    temporalShader->setUniformValue("u_maxHistory", TEMPORAL_MAX_HISTORY);
+
+    glDisable(GL_DEPTH_TEST);
+    drawFullScreen(ctx);
+    glEnable(GL_DEPTH_TEST);
+    temporalShader->release();
+    historyFbo[dst]->release();
+
+    historyIndex = dst;
+    prevVpMat = vpMat;
+    prevMvMat = mvMat;
+    historyValid = true;
+    stillFrames++;
+}
+
+bool RsmTechnique::isConverging() const {
+    return temporal && stillFrames < (int)TEMPORAL_MAX_HISTORY;
+}
+
+// Low-resolution size over the window size
+QVector2D RsmTechnique::indirectRatio(const RenderContext &ctx) const {
+    return QVector2D((float)indirectFbo->width() / ctx.viewport[2],
+                     (float)indirectFbo->height() / ctx.viewport[3]);
+}
+
+void RsmTechnique::renderShadowMap(const RenderContext &ctx) {
+    ctx.profiler->beginPass("rsm");
+    glViewport(0, 0, rsmFbo->width(), rsmFbo->height());
+
+    rsmShader->bind();
+    rsmFbo->bind();
+
+    rsmShader->setUniformValue("u_projMat", ctx.light.projMat);
+    rsmShader->setUniformValueArray("u_mvMat", &ctx.light.viewMat[0], 6);
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    if (rsmFormat == RsmFormat::Full) {
+        float white[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        glClearBufferfv(GL_COLOR, 0, white);
+    }
+
+    drawShadowCasters(ctx, *rsmShader);
+
+    rsmShader->release();
+    rsmFbo->release();
+
+    if (ctx.dumper->isRequested()) {
+        std::vector<DumpChannel> channels;
+        for (const auto &att : rsmLayout) {
+            if (!att.name.empty()) {
+                channels.push_back({ att.name, att.attachment, att.pixelFormat });
+            }
+        }
+        captureShadowMap(ctx, *rsmFbo, channels);
+    }
+}
+
+void RsmTechnique::bindTextures(QOpenGLShaderProgram &program) {
+    for (int i = 0; i < (int)rsmLayout.size(); i++) {
+        if (rsmLayout[i].sampler.empty()) continue;
+
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(rsmTargets[i]->desc().target, rsmTargets[i]->textureId());
+        program.setUniformValue(rsmLayout[i].sampler.c_str(), i);
+    }
+}
@@ -0,0 +1,110 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _RSM_TECHNIQUE_H_
+#define _RSM_TECHNIQUE_H_
+
+#include <memory>
+
+#include "shadowtechnique.h"
+
+// Reflective shadow maps: the cube atlas stores depth, normal and flux,
+// and the scene pass gathers one bounce of indirect light from it. With a
+// downsample factor above one the gather runs in a separate pass at that
+// fraction of the window resolution, and the scene pass upsamples the
+// result with a depth- and normal-aware bilateral filter. In deferred
+// mode both read the camera G-buffer instead of rasterizing the scene.
+//
+// Temporal mode also splits the gather off, rotates its sample pattern
+// every frame and blends the result with the reprojected history, so a
+// few samples per frame converge to many while the camera rests.
+//
+// With the mip hierarchy the RSM is also merged into a flux-weighted
+// pyramid of pixel lights after it is rendered, and kernel samples far
+// from the center, where the kernel is sparse, read a coarser level so
+// that each stands for the whole area around it.
+class RsmTechnique : public ShadowTechnique {
+public:
+    void initialize(const RenderContext &ctx) override;
+    void release() override;
+    void render(const RenderContext &ctx) override;
+
+    // Until the temporal history is full
+    bool isConverging() const override;
+
+    // Building blocks for techniques that start from an RSM (see ISM).
+    // update() rebuilds whatever the settings of the context invalidate and
+    // reports whether shaders including rsmsample.glsl need recompiling.
+    bool update(const RenderContext &ctx);
+    void renderShadowMap(const RenderContext &ctx);
+    void bindTextures(QOpenGLShaderProgram &program);
+
+    // Defines for every shader that includes rsmsample.glsl
+    std::vector<std::string> shaderDefines() const;
+
+private:
+    void compileShaders();
+    void compileSceneShaders();
+    void createTargets(const RenderContext &ctx);
+    void createKernel(int nSamples, float radius, int faceSize, int levels);
+    void createMipTargets(const RenderContext &ctx, int levels);
+    void releaseMipTargets();
+    void renderHierarchy(const RenderContext &ctx);
+    void createIndirectTargets(const RenderContext &ctx, int width, int height);
+    void releaseIndirectTargets();
+    void setGatherUniforms(QOpenGLShaderProgram &program);
+    void renderIndirect(const RenderContext &ctx);
+    void resolveTemporal(const RenderContext &ctx);
+    QVector2D indirectRatio(const RenderContext &ctx) const;
+
+    // Whether the gather runs in its own pass before the scene pass
+    inline bool splitIndirect() const { return indirectDownsample > 1 || temporal; }
+
+    std::unique_ptr<QOpenGLShaderProgram> rsmShader = nullptr;
+    std::unique_ptr<QOpenGLShaderProgram> shader = nullptr;
+    std::unique_ptr<QOpenGLShaderProgram> indirectShader = nullptr;
+    std::unique_ptr<QOpenGLShaderProgram> temporalShader = nullptr;
+    std::unique_ptr<QOpenGLShaderProgram> mipBaseShader = nullptr;
+    std::unique_ptr<QOpenGLShaderProgram> mipShader = nullptr;
+    std::unique_ptr<Framebuffer> rsmFbo = nullptr;
+    std::vector<std::shared_ptr<RenderTarget>> rsmTargets;
+    std::vector<RsmAttachment> rsmLayout;
+    RsmFormat rsmFormat = RsmFormat::Compact;
+    ShadowMapLayout layout = ShadowMapLayout::Atlas;
+    int shadowMapSize = 0;
+
+    // Reduced-resolution gather: depth, indirect light, normal and depth
+    std::unique_ptr<Framebuffer> indirectFbo = nullptr;
+    std::vector<std::shared_ptr<RenderTarget>> indirectTargets;
+    int indirectDownsample = 1;
+    bool deferred = false;
+
+    // Temporal accumulation: the history ping-pongs between two targets,
+    // and the geometry of the previous frame is kept for reprojection
+    std::unique_ptr<Framebuffer> historyFbo[2];
+    std::shared_ptr<RenderTarget> historyTargets[2];
+    std::shared_ptr<RenderTarget> prevGeometry;
+    QMatrix4x4 prevVpMat;
+    QMatrix4x4 prevMvMat;
+    bool temporal = false;
+    bool historyValid = false;
+    int historyIndex = 0;
+    int stillFrames = 0;
+    int frameIndex = 0;
+
+    // Gather kernel in a std140 uniform block (see rsmgather.glsl)
+    GLuint kernelBuffer = 0;
+    int kernelSamples = 0;
+    float kernelRadius = 0.0f;
+    int kernelFaceSize = 0;
+    int kernelLevels = 0;
+
+    // Gather hierarchy: position, normal and flux levels of a half-size
+    // atlas, with a framebuffer per level
+    std::vector<std::unique_ptr<Framebuffer>> mipFbos;
+    std::vector<std::shared_ptr<RenderTarget>> mipTargets;
+    bool hierarchy = false;
+};
+
+#endif  // _RSM_TECHNIQUE_H_
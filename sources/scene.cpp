@@ -0,0 +1,337 @@
+#include "scene.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <mutex>
+#include <algorithm>
+
+#include <QtCore/qfileinfo.h>
+#include <QtCore/qdir.h>
+#include <QtCore/qrunnable.h>
+#include <QtCore/qthread.h>
+
+// Prepared meshes handed from the workers to the GL thread. Results of a
+// load that was abandoned are dropped.
+class MeshLoadQueue {
+public:
+    typedef std::pair<size_t, std::unique_ptr<PreparedMesh>> Result;
+
+    int generation() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return generation_;
+    }
+
+    int restart() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        finished_.clear();
+        return ++generation_;
+    }
+
+    void push(int generation, size_t index, std::unique_ptr<PreparedMesh> mesh) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (generation != generation_) return;
+        finished_.emplace_back(index, std::move(mesh));
+    }
+
+    std::vector<Result> take() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<Result> results;
+        std::swap(results, finished_);
+        return results;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    int generation_ = 0;
+    std::vector<Result> finished_;
+};
+
+namespace {
+
+// Parses one mesh on a worker; a null result marks a failed load
+class MeshLoadTask : public QRunnable {
+public:
+    MeshLoadTask(const std::shared_ptr<MeshLoadQueue> &queue, int generation, size_t index,
+                 const std::string &path, VertexLayout layout, bool optimize)
+        : queue_(queue)
+        , generation_(generation)
+        , index_(index)
+        , path_(path)
+        , layout_(layout)
+        , optimize_(optimize) {
+    }
+
+    void run() override {
+        // Abandoned before it started
+        if (queue_->generation() != generation_) return;
+
+        // Nothing may escape a pool thread; a failure marks the mesh
+        std::unique_ptr<PreparedMesh> mesh(new PreparedMesh());
+        try {
+            // The pool already parses one mesh per core
+            MeshLoader loader(layout_, optimize_);
+            loader.setParseThreads(1);
+            if (!loader.load(path_, mesh.get())) {
+                mesh.reset();
+            }
+        } catch (const std::exception &e) {
+            std::cerr << "[ERROR] failed to load " << path_ << ": " << e.what() << std::endl;
+            mesh.reset();
+        }
+        queue_->push(generation_, index_, std::move(mesh));
+    }
+
+private:
+    std::shared_ptr<MeshLoadQueue> queue_;
+    int generation_;
+    size_t index_;
+    std::string path_;
+    VertexLayout layout_;
+    bool optimize_;
+};
+
+}  // anonymous namespace
+
+Scene::Scene()
+    : queue_(std::make_shared<MeshLoadQueue>()) {
+    // Leave a core for the GL thread
+    workers_.setMaxThreadCount(std::max(1, QThread::idealThreadCount() - 1));
+}
+
+Scene::~Scene() {
+    queue_->restart();
+    workers_.clear();
+    workers_.waitForDone();
+}
+
+bool Scene::load(const std::string &filename, VertexLayout layout, bool optimize) {
+    release();
+    filename_ = filename;
+    layout_ = layout;
+    optimize_ = optimize;
+
+    std::vector<Entry> entries;
+    if (!parse(filename, &entries)) {
+        return false;
+    }
+
+    // Instances of one file share its mesh, in order of first appearance
+    std::map<std::string, size_t> meshIndex;
+    std::vector<std::string> paths;
+    std::vector<std::vector<QMatrix4x4>> transforms;
+    for (const auto &e : entries) {
+        auto it = meshIndex.find(e.path);
+        if (it == meshIndex.end()) {
+            it = meshIndex.insert(std::make_pair(e.path, paths.size())).first;
+            paths.push_back(e.path);
+            transforms.emplace_back();
+        }
+        transforms[it->second].push_back(e.transform);
+    }
+
+    const int generation = queue_->generation();
+    for (size_t i = 0; i < paths.size(); i++) {
+        meshes_.push_back(std::make_unique<VertexArray>());
+        meshes_.back()->setInstances(transforms[i]);
+        workers_.start(new MeshLoadTask(queue_, generation, i, paths[i], layout, optimize));
+    }
+    failed_.assign(meshes_.size(), false);
+    pendingLoads_ = (int)paths.size();
+    loading_ = pendingLoads_ > 0;
+    loadTimer_.start();
+
+    std::cout << "[ INFO ] Loading scene " << filename << ": " << meshCount() << " meshes, "
+              << instanceCount() << " instances" << std::endl;
+    return true;
+}
+
+void Scene::release() {
+    // Workers still parsing for the old scene finish into the void
+    queue_->restart();
+    workers_.clear();
+
+    meshes_.clear();
+    failed_.clear();
+    pendingLoads_ = 0;
+    loading_ = false;
+    ring_.release();
+
+    bboxMin_ = QVector3D(0.0f, 0.0f, 0.0f);
+    bboxMax_ = QVector3D(0.0f, 0.0f, 0.0f);
+    drawnClusters_ = 0;
+    drawnTriangles_ = 0;
+}
+
+bool Scene::update(size_t budget) {
+    if (!loading_) return false;
+
+    bool created = false;
+    for (auto &result : queue_->take()) {
+        pendingLoads_--;
+        if (!result.second) {
+            failed_[result.first] = true;
+            continue;
+        }
+        meshes_[result.first]->create(std::move(result.second));
+        created = true;
+    }
+    if (created) {
+        updateBounds();
+    }
+
+    size_t uploaded = 0;
+    bool uploading = false;
+    for (auto &mesh : meshes_) {
+        if (!mesh->isCreated() || mesh->isUploaded()) continue;
+        if (uploaded < budget) {
+            uploaded += mesh->upload(ring_, budget - uploaded);
+        }
+        uploading = uploading || !mesh->isUploaded();
+    }
+
+    if (pendingLoads_ == 0 && !uploading) {
+        loading_ = false;
+        const int failed = (int)std::count(failed_.begin(), failed_.end(), true);
+        if (failed == meshCount()) {
+            std::cerr << "[ERROR] scene has no meshes: " << filename_ << std::endl;
+        }
+        std::cout << "[ INFO ] Scene " << filename_ << " loaded in " << loadTimer_.elapsed() << " ms: "
+                  << meshCount() - failed << " meshes, " << instanceCount() << " instances, "
+                  << clusterCount() << " clusters" << std::endl;
+    }
+    return created;
+}
+
+float Scene::progress() const {
+    if (meshes_.empty()) return 1.0f;
+
+    // Parsing and uploading count half each; failed meshes are done
+    float sum = 0.0f;
+    for (size_t i = 0; i < meshes_.size(); i++) {
+        if (failed_[i]) {
+            sum += 1.0f;
+        } else if (meshes_[i]->isCreated()) {
+            sum += 0.5f + 0.5f * meshes_[i]->uploadProgress();
+        }
+    }
+    return sum / meshes_.size();
+}
+
+void Scene::draw(QOpenGLShaderProgram &shader, const ClusterCuller *culler) const {
+    drawnClusters_ = 0;
+    drawnTriangles_ = 0;
+    for (const auto &mesh : meshes_) {
+        mesh->draw(shader, culler);
+        drawnClusters_ += mesh->drawnClusters();
+        drawnTriangles_ += mesh->drawnTriangles();
+    }
+}
+
+void Scene::drawPoints() const {
+    for (const auto &mesh : meshes_) {
+        mesh->drawPoints();
+    }
+}
+
+int Scene::instanceCount() const {
+    int count = 0;
+    for (const auto &mesh : meshes_) {
+        count += mesh->instanceCount();
+    }
+    return count;
+}
+
+int Scene::clusterCount() const {
+    int count = 0;
+    for (const auto &mesh : meshes_) {
+        count += mesh->clusterCount();
+    }
+    return count;
+}
+
+bool Scene::parse(const std::string &filename, std::vector<Entry> *entries) const {
+    const QFileInfo info(QString::fromStdString(filename));
+    if (!info.exists()) {
+        std::cerr << "[ERROR] scene file not found: " << filename << std::endl;
+        return false;
+    }
+
+    if (info.suffix().toLower() == "ply") {
+        entries->push_back({ info.canonicalFilePath().toStdString(), QMatrix4x4() });
+        return true;
+    }
+
+    std::ifstream reader(filename, std::ios::in);
+    if (reader.fail()) {
+        std::cerr << "[ERROR] failed to open scene file: " << filename << std::endl;
+        return false;
+    }
+
+    const QDir dir = info.absoluteDir();
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(reader, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream ss(line);
+        std::string path;
+        if (!(ss >> path)) continue;
+
+        // translation, scale, yaw; a failed read would zero the value
+        float values[5] = { 0.0f, 0.0f, 0.0f, 1.0f, 0.0f };
+        for (float &v : values) {
+            float x;
+            if (!(ss >> x)) break;
+            v = x;
+        }
+        const float tx = values[0], ty = values[1], tz = values[2], scale = values[3], yaw = values[4];
+
+        const QFileInfo mesh(dir, QString::fromStdString(path));
+        if (!mesh.exists()) {
+            std::cerr << "[ERROR] " << filename << ":" << lineNumber
+                      << ": mesh not found: " << path << std::endl;
+            continue;
+        }
+
+        // Instance culling assumes a uniform, positive scale
+        Entry e;
+        e.path = mesh.canonicalFilePath().toStdString();
+        e.transform.translate(tx, ty, tz);
+        e.transform.rotate(yaw, 0.0f, 1.0f, 0.0f);
+        e.transform.scale(std::max(scale, 1.0e-6f));
+        entries->push_back(e);
+    }
+    return true;
+}
+
+void Scene::updateBounds() {
+    bboxMin_ = QVector3D( 1.0e20f,  1.0e20f,  1.0e20f);
+    bboxMax_ = QVector3D(-1.0e20f, -1.0e20f, -1.0e20f);
+    bool empty = true;
+    for (const auto &mesh : meshes_) {
+        if (!mesh->isCreated()) continue;
+        empty = false;
+
+        const QVector3D lo = mesh->bboxMin();
+        const QVector3D hi = mesh->bboxMax();
+        for (const auto &m : mesh->instances()) {
+            for (int corner = 0; corner < 8; corner++) {
+                const QVector3D p = m.map(QVector3D(corner & 1 ? hi.x() : lo.x(),
+                                                    corner & 2 ? hi.y() : lo.y(),
+                                                    corner & 4 ? hi.z() : lo.z()));
+                for (int k = 0; k < 3; k++) {
+                    bboxMin_[k] = std::min(bboxMin_[k], p[k]);
+                    bboxMax_[k] = std::max(bboxMax_[k], p[k]);
+                }
+            }
+        }
+    }
+
+    if (empty) {
+        bboxMin_ = QVector3D(0.0f, 0.0f, 0.0f);
+        bboxMax_ = QVector3D(0.0f, 0.0f, 0.0f);
+    }
+}
@@ -0,0 +1,113 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _SCENE_H_
+#define _SCENE_H_
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qthreadpool.h>
+#include <QtGui/qmatrix4x4.h>
+#include <QtGui/qopenglshaderprogram.h>
+
+#include "vertexarray.h"
+#include "stagingring.h"
+
+class MeshLoadQueue;
+
+// Flat list of meshes, each drawn once per instance.
+//
+// A scene file lists one instance per line:
+//
+//     # file             translation     scale  yaw (degrees)
+//     cbox.ply
+//     bunny.ply          1.0 0.0 -2.0    0.5    90
+//
+// Paths are relative to the scene file; trailing values may be left out.
+// Lines naming the same file share one VertexArray, whose copies are drawn
+// with a single instanced draw per cluster run, so every pass costs the
+// unique geometry rather than the number of instances. A .ply file is
+// loaded as a scene with one instance.
+//
+// Loading does not block: meshes are parsed on a worker pool, and update()
+// uploads what has arrived through a staging ring within a per-frame
+// budget. Meshes are drawn as far as they are uploaded.
+class Scene {
+public:
+    Scene();
+    virtual ~Scene();
+
+    // Reads the scene file and starts loading its meshes. Returns false if
+    // the file cannot be read. A running load is abandoned.
+    bool load(const std::string &filename, VertexLayout layout, bool optimize);
+
+    // Frees the meshes and the staging ring; the context must be current
+    void release();
+
+    // Takes the meshes the workers have finished and uploads up to budget
+    // bytes. Returns true if the scene bounds changed. The context must be
+    // current.
+    bool update(size_t budget);
+
+    inline bool isLoading() const { return loading_; }
+
+    // 0 to 1 over parsing and uploading every mesh
+    float progress() const;
+
+    // Sum of the meshes' draw() with the same culler
+    void draw(QOpenGLShaderProgram &shader, const ClusterCuller *culler = nullptr) const;
+    void drawPoints() const;
+
+    inline const std::string &filename() const { return filename_; }
+    inline VertexLayout layout() const { return layout_; }
+    inline bool optimize() const { return optimize_; }
+
+    // World-space bounds over every instance of the meshes loaded so far
+    inline QVector3D bboxMin() const { return bboxMin_; }
+    inline QVector3D bboxMax() const { return bboxMax_; }
+    inline float boundingRadius() const { return 0.5f * (bboxMax_ - bboxMin_).length(); }
+
+    inline int meshCount() const { return (int)meshes_.size(); }
+    int instanceCount() const;
+
+    // Clusters of the unique meshes, and those drawn by the last draw()
+    // counted once however many instances saw them
+    int clusterCount() const;
+    inline int drawnClusters() const { return drawnClusters_; }
+    inline int drawnTriangles() const { return drawnTriangles_; }
+
+private:
+    struct Entry {
+        std::string path;
+        QMatrix4x4 transform;
+    };
+
+    bool parse(const std::string &filename, std::vector<Entry> *entries) const;
+    void updateBounds();
+
+    std::vector<std::unique_ptr<VertexArray>> meshes_;
+    std::vector<bool> failed_;
+    int pendingLoads_ = 0;
+    bool loading_ = false;
+    QElapsedTimer loadTimer_;
+
+    std::shared_ptr<MeshLoadQueue> queue_;
+    QThreadPool workers_;
+    StagingRing ring_;
+
+    std::string filename_;
+    VertexLayout layout_ = VertexLayout::Float;
+    bool optimize_ = false;
+
+    QVector3D bboxMin_;
+    QVector3D bboxMax_;
+
+    mutable int drawnClusters_ = 0;
+    mutable int drawnTriangles_ = 0;
+};
+
+#endif  // _SCENE_H_
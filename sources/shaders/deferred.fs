@@ -0,0 +1,26 @@
+#version 330
+
+out vec4 out_color;
+
+#include "rsmsample.glsl"
+#include "rsmgather.glsl"
+#include "upsample.glsl"
+#include "shading.glsl"
+#include "gbuffer.glsl"
+
+uniform mat4 u_mvMat;
+uniform vec3 u_lightPos;
+
+// Lights each pixel of the G-buffer once, however many surfaces were
+// rasterized behind it
+void main(void) {
+    vec3 posWorld, nrmWorld, color;
+    if (!gbufferSurface(ivec2(gl_FragCoord.xy), posWorld, nrmWorld, color)) {
+        out_color = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+
+    float depthView = -(u_mvMat * vec4(posWorld, 1.0)).z;
+    out_color.rgb = shade(posWorld, nrmWorld, color, depthView, u_lightPos);
+    out_color.a = 1.0;
+}
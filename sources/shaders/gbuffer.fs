@@ -0,0 +1,15 @@
+#version 330
+
+#include "packing.glsl"
+
+in vec3 f_nrmWorld;
+in vec3 f_color;
+
+layout(location = 0) out vec4 out_normal;
+layout(location = 1) out vec4 out_albedo;
+
+// Position is reconstructed from the depth attachment (see gbuffer.glsl)
+void main(void) {
+    out_normal = vec4(encodeOctahedral(normalize(f_nrmWorld)), 0.0, 0.0);
+    out_albedo = vec4(f_color, 1.0);
+}
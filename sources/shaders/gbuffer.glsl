@@ -0,0 +1,23 @@
+// Camera G-buffer written by gbuffer.fs: depth, octahedral world normal
+// and albedo. Needs packing.glsl.
+
+uniform sampler2D u_gbufferDepth;
+uniform sampler2D u_gbufferNormal;
+uniform sampler2D u_gbufferAlbedo;
+
+uniform mat4 u_invVpMat;
+
+// Surface seen through a pixel; false where only the background is
+bool gbufferSurface(ivec2 pixel, out vec3 posWorld, out vec3 nrmWorld, out vec3 color) {
+    float depth = texelFetch(u_gbufferDepth, pixel, 0).x;
+    if (depth >= 1.0) {
+        return false;
+    }
+
+    vec2 ndc = (vec2(pixel) + 0.5) / vec2(textureSize(u_gbufferDepth, 0)) * 2.0 - 1.0;
+    vec4 pos = u_invVpMat * vec4(ndc, depth * 2.0 - 1.0, 1.0);
+    posWorld = pos.xyz / pos.w;
+    nrmWorld = decodeOctahedral(texelFetch(u_gbufferNormal, pixel, 0).xy);
+    color = texelFetch(u_gbufferAlbedo, pixel, 0).rgb;
+    return true;
+}
@@ -0,0 +1,20 @@
+#version 330
+
+#include "vertex.glsl"
+
+layout(location = 0) in vec3 in_position;
+layout(location = 1) in vec3 in_normal;
+layout(location = 2) in vec4 in_color;
+
+out vec3 f_nrmWorld;
+out vec3 f_color;
+
+uniform mat4 u_mvpMat;
+
+void main(void) {
+    vec3 position = instancePosition(in_position);
+
+    gl_Position = u_mvpMat * vec4(position, 1.0);
+    f_nrmWorld = instanceNormal(in_normal);
+    f_color = in_color.rgb;
+}
@@ -0,0 +1,44 @@
+#version 330
+
+layout(location = 0) out vec4 out_indirect;
+layout(location = 1) out vec4 out_geometry;
+
+#include "rsmsample.glsl"
+#include "rsmgather.glsl"
+
+uniform vec3 u_lightPos;
+
+#ifdef DEFERRED
+#include "gbuffer.glsl"
+
+uniform mat4 u_mvMat;
+uniform vec2 u_indirectRatio;
+#else
+in vec3 f_posWorld;
+in vec3 f_nrmWorld;
+in float f_depthView;
+#endif
+
+// RSM gather at reduced resolution. The normal and view depth of each
+// texel guide the bilateral upsampling (upsample.glsl); a cleared texel has
+// zero depth and is never used. DEFERRED reads the surface from the
+// G-buffer pixel under the texel center instead of rasterizing the scene.
+void main(void) {
+#ifdef DEFERRED
+    ivec2 pixel = min(ivec2(gl_FragCoord.xy / u_indirectRatio), textureSize(u_gbufferDepth, 0) - 1);
+    vec3 posWorld, nrmWorld, color;
+    if (!gbufferSurface(pixel, posWorld, nrmWorld, color)) {
+        out_indirect = vec4(0.0);
+        out_geometry = vec4(0.0);
+        return;
+    }
+    float depthView = -(u_mvMat * vec4(posWorld, 1.0)).z;
+#else
+    vec3 posWorld = f_posWorld;
+    vec3 nrmWorld = f_nrmWorld;
+    float depthView = f_depthView;
+#endif
+
+    out_indirect = vec4(rsmIndirect(posWorld, nrmWorld, u_lightPos), 1.0);
+    out_geometry = vec4(normalize(nrmWorld), depthView);
+}
@@ -0,0 +1,31 @@
+#version 330
+
+#ifdef DEFERRED
+// Full-screen triangle over the G-buffer
+void main(void) {
+    vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);
+}
+#else
+#include "vertex.glsl"
+
+layout(location = 0) in vec3 in_position;
+layout(location = 1) in vec3 in_normal;
+
+out vec3 f_posWorld;
+out vec3 f_nrmWorld;
+out float f_depthView;
+
+uniform mat4 u_mvMat;
+uniform mat4 u_mvpMat;
+
+void main(void) {
+    vec3 position = instancePosition(in_position);
+    vec3 normal = instanceNormal(in_normal);
+
+    gl_Position = u_mvpMat * vec4(position, 1.0);
+    f_posWorld = position;
+    f_nrmWorld = normal;
+    f_depthView = -(u_mvMat * vec4(position, 1.0)).z;
+}
+#endif
@@ -1,9 +1,9 @@
 #version 330
 
-in float depth;
-out vec4 color;
+in float f_depth;
+
+out vec4 out_depth;
 
 void main(void) {
-    if (depth < 0.0) discard;
-    color = vec4(depth, depth, depth, 1.0);
+    out_depth = vec4(f_depth, f_depth, f_depth, 1.0);
 }
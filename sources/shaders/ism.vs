@@ -1,7 +1,8 @@
 #version 330
 
-in vec3 vertices;
+layout(location = 0) in vec3 in_position;
+layout(location = 3) in mat4 in_instanceMat;
 
 void main(void) {
-  gl_Position = vec4(vertices, 1.0);
+    gl_Position = in_instanceMat * vec4(in_position, 1.0);
 }
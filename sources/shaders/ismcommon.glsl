@@ -0,0 +1,46 @@
+// Shared by the ISM splatting and ISM lighting passes. VPLs are stored in
+// u_ismCols x u_ismRows textures written by vpl.fs.
+
+uniform sampler2D u_vplPosition;
+uniform sampler2D u_vplNormal;
+uniform sampler2D u_vplFlux;
+
+uniform int u_ismRows;
+uniform int u_ismCols;
+uniform float u_maxDepth;
+
+const float Pi = 3.14159265358979;
+
+// Paraboloid-like mapping of the hemisphere around -z. The returned z is
+// the normalized distance, or -1 behind the VPL.
+vec3 sphericalMap(vec3 posCam) {
+    vec3 pos = posCam / u_maxDepth;
+    float pz = length(pos);
+    if (pos.z > 0.0) {
+        pz = -1.0;
+    }
+
+    pos = normalize(pos);
+    float theta = acos(-pos.z);
+    if (theta > Pi * 0.5) {
+        theta = Pi - theta;
+    }
+
+    float len = max(1.0e-6, sqrt(pos.x * pos.x + pos.y * pos.y));
+    return vec3(pos.xy / len * theta / (Pi * 0.5), pz);
+}
+
+// World position in the frame of a VPL looking along its normal (-z)
+vec3 vplSpace(ivec2 vpl, vec3 posWorld) {
+    vec3 origin = texelFetch(u_vplPosition, vpl, 0).xyz;
+    vec3 n = texelFetch(u_vplNormal, vpl, 0).xyz;
+    vec3 t = normalize(abs(n.y) < 0.99 ? cross(n, vec3(0.0, 1.0, 0.0)) : cross(n, vec3(1.0, 0.0, 0.0)));
+    vec3 b = cross(n, t);
+    vec3 d = posWorld - origin;
+    return vec3(dot(d, t), dot(d, b), -dot(d, n));
+}
+
+// Lower-left corner of the ISM tile for a VPL in [0, 1] atlas coordinates
+vec2 ismTileOrigin(ivec2 vpl) {
+    return vec2(vpl) / vec2(u_ismCols, u_ismRows);
+}
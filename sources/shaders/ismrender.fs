@@ -1,77 +1,45 @@
 #version 330
 
-#define MAX_VPLs 32
+#include "ismcommon.glsl"
 
-uniform sampler2D ismTexture;
-uniform sampler2D accumTexture;
+uniform sampler2D u_ismMap;
+uniform sampler2D u_accumMap;
 
-uniform vec3 posVPL[MAX_VPLs];
-uniform vec3 nrmVPL[MAX_VPLs];
-uniform vec3 albVPL[MAX_VPLs];
-uniform mat4 mvVPL[MAX_VPLs];
+uniform int u_currentRow;
+uniform float u_bias;
 
-uniform int currentRow;
-uniform int ismRows;
-uniform int ismCols;
-uniform float maxDepth;
+in vec3 f_posWorld;
+in vec3 f_nrmWorld;
 
-in vec3 vertexWorldspace;
-in vec3 normalWorldspace;
-in vec3 lightWorldspace;
-in vec3 vertexColor;
-in vec4 vertexScreenspace;
-
-out vec4 color;
-
-float Pi = 4.0 * atan(1.0);
-
-vec3 sphericalMap(vec3 posCam) {
-    vec3 pos = posCam / maxDepth;
-    float pz = length(pos);
-    if (pos.z > 0.0) {
-        pz = -1.0;
-    }
-
-    pos = normalize(pos);
-    float theta = acos(-pos.z);
-    if (theta > Pi * 0.5) {
-        theta = Pi - theta;
-    }
-
-    float len = sqrt(pos.x * pos.x + pos.y * pos.y);
-    return vec3(pos.xy / len * theta / (Pi * 0.5), pz);
-}
+out vec4 out_color;
 
 vec3 reflectiveSM(vec3 V, vec3 N, vec3 Vp, vec3 Np, vec3 Phi) {
-    vec3 ret = vec3(0.0, 0.0, 0.0);
     return Phi * max(0.0, dot(Np, V - Vp)) * max(0.0, dot(N, Vp - V)) / pow(length(V - Vp), 4.0);
 }
 
-vec3 calcIndirect(vec3 V, vec3 N) {
-    float bias = 0.05;
-    vec3 indirect = vec3(0.0, 0.0, 0.0);
-    for (int j = 0; j < MAX_VPLs; j++) {
-        vec4 posCam = mvVPL[j] * vec4(vertexWorldspace, 1.0);
-        posCam /= posCam.w;
-        vec3 posSph = sphericalMap(posCam.xyz);
-
-        vec2 texCoord = posSph.xy * 0.5 + 0.5;
-        texCoord.x = (texCoord.x + j) / ismCols;
-        texCoord.y = (texCoord.y + currentRow) / ismRows;
-        float distFromVPL = texture(ismTexture, texCoord).z;
+// Indirect light from the VPLs of the current row, added to the running
+// sum of the previous rows.
+void main(void) {
+    vec3 N = normalize(f_nrmWorld);
+    vec2 tileSize = 1.0 / vec2(u_ismCols, u_ismRows);
 
-        if (distFromVPL + bias >= posSph.z && posCam.w > 0.0) {
-            indirect += reflectiveSM(V, N, posVPL[j], nrmVPL[j], albVPL[j]);
+    vec3 indirect = vec3(0.0, 0.0, 0.0);
+    for (int j = 0; j < u_ismCols; j++) {
+        ivec2 vpl = ivec2(j, u_currentRow);
+        vec3 posSph = sphericalMap(vplSpace(vpl, f_posWorld));
+        if (posSph.z < 0.0) continue;
+
+        vec2 uv = ismTileOrigin(vpl) + (posSph.xy * 0.5 + 0.5) * tileSize;
+        float distFromVPL = texture(u_ismMap, uv).x;
+        if (distFromVPL + u_bias >= posSph.z) {
+            vec3 Vp = texelFetch(u_vplPosition, vpl, 0).xyz;
+            vec3 Np = texelFetch(u_vplNormal, vpl, 0).xyz;
+            vec3 Phi = texelFetch(u_vplFlux, vpl, 0).rgb;
+            indirect += reflectiveSM(f_posWorld, N, Vp, Np, Phi);
         }
     }
-    return 4.0 * Pi * indirect / (ismRows * ismCols);
-}
-
-void main(void) {
-    vec3 indirect = calcIndirect(vertexWorldspace, normalWorldspace);
+    indirect = 4.0 * Pi * indirect / float(u_ismRows * u_ismCols);
 
-    vec2 texCoord = vertexScreenspace.xy / vertexScreenspace.w;
-    texCoord = texCoord * 0.5 + 0.5;
-    vec3 accum = texture2D(accumTexture, texCoord).xyz;
-    color = vec4(accum + indirect, 1.0);
+    vec3 accum = texelFetch(u_accumMap, ivec2(gl_FragCoord.xy), 0).rgb;
+    out_color = vec4(accum + indirect, 1.0);
 }
@@ -1,5 +1,7 @@
 #version 330
 
+#include "vertex.glsl"
+
 layout(location = 0) in vec3 in_position;
 layout(location = 1) in vec3 in_normal;
 layout(location = 2) in vec4 in_color;
@@ -11,23 +13,22 @@ out vec3 f_color;
 
 out vec3 f_posWorld;
 out vec3 f_nrmWorld;
-out vec4 f_posLightSpace;
 
 uniform mat4 u_mvMat;
 uniform mat4 u_mvpMat;
 uniform vec3 u_lightPos;
 
-uniform mat4 u_lightMvpMat;
-
 void main(void) {
-    gl_Position = u_mvpMat * vec4(in_position, 1.0);
+    vec3 position = instancePosition(in_position);
+    vec3 normal = instanceNormal(in_normal);
+
+    gl_Position = u_mvpMat * vec4(position, 1.0);
 
-    f_posView = (u_mvMat * vec4(in_position, 1.0)).xyz;
-    f_nrmView = (transpose(inverse(u_mvMat)) * vec4(in_normal, 1.0)).xyz;
+    f_posView = (u_mvMat * vec4(position, 1.0)).xyz;
+    f_nrmView = (transpose(inverse(u_mvMat)) * vec4(normal, 1.0)).xyz;
     f_lightPos = (u_mvMat * vec4(u_lightPos, 1.0)).xyz;
     f_color   = in_color.rgb;
 
-    f_posWorld = in_position;
-    f_nrmWorld = in_normal;
-    f_posLightSpace = u_lightMvpMat * vec4(in_position, 1.0);
+    f_posWorld = position;
+    f_nrmWorld = normal;
 }
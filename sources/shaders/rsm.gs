@@ -14,25 +14,65 @@ out vec4 f_color;
 
 uniform mat4 u_projMat;
 uniform mat4 u_mvMat[6];
+uniform vec3 u_lightPos;
 
 int cubeX[6] = int[6]( 0, 2, 1, 1, 1, 3 );
 int cubeY[6] = int[6]( 1, 1, 0, 2, 1, 1 );
 
+// True if all three vertices lie beyond the same clip plane
+bool outsideFrustum(vec4 p0, vec4 p1, vec4 p2) {
+    for (int axis = 0; axis < 3; axis++) {
+        if (p0[axis] > p0.w && p1[axis] > p1.w && p2[axis] > p2.w) return true;
+        if (p0[axis] < -p0.w && p1[axis] < -p1.w && p2[axis] < -p2.w) return true;
+    }
+    return false;
+}
+
 void main(void) {
+    // Triangles facing away from the light cannot be seen from any face
+    vec3 faceNormal = cross(g_position[1] - g_position[0], g_position[2] - g_position[0]);
+    if (dot(faceNormal, u_lightPos - g_position[0]) <= 0.0) {
+        return;
+    }
+
     float scaleX = 1.0 / 4.0;
     float scaleY = 1.0 / 3.0;
-    float aspect = 3.0 / 4.0;
 
     for (int i = 0; i < 6; i++) {
         mat4 mvpMat = u_projMat * u_mvMat[i];
+        vec4 clip[3];
         for (int k = 0; k < 3; k++) {
-            gl_Position = mvpMat * vec4(g_position[k], 1.0);
-            gl_Position.x = scaleX * gl_Position.x + scaleX * (2.0 * cubeX[i] + 1.0) - 1.0;
-            gl_Position.y = scaleY * gl_Position.y + scaleY * (2.0 * (2 - cubeY[i]) + 1.0) - 1.0;
+            clip[k] = mvpMat * vec4(g_position[k], 1.0);
+        }
+
+        // Only faces the triangle overlaps get a copy
+        if (outsideFrustum(clip[0], clip[1], clip[2])) {
+            continue;
+        }
+
+        for (int k = 0; k < 3; k++) {
+            vec4 p = clip[k];
+#ifdef RSM_LAYERED
+            gl_Layer = i;
+            gl_Position = p;
+#else
+            // The cell offset is applied before the perspective divide, so
+            // it scales with w like the rest of the position
+            gl_Position = p;
+            gl_Position.x = scaleX * p.x + (scaleX * (2.0 * cubeX[i] + 1.0) - 1.0) * p.w;
+            gl_Position.y = scaleY * p.y + (scaleY * (2.0 * (2 - cubeY[i]) + 1.0) - 1.0) * p.w;
+#endif
+
+            // Side planes of the face frustum. In the atlas they keep the
+            // copy inside its cell, which the clip volume does not.
+            gl_ClipDistance[0] = p.w - p.x;
+            gl_ClipDistance[1] = p.w + p.x;
+            gl_ClipDistance[2] = p.w - p.y;
+            gl_ClipDistance[3] = p.w + p.y;
 
             f_posWorld = g_position[k];
             f_nrmWorld = g_normal[k];
-            f_posScreen = mvpMat * vec4(g_position[k], 1.0);
+            f_posScreen = clip[k];
             f_color = g_color[k];
 
             EmitVertex();
@@ -1,5 +1,7 @@
 #version 330
 
+#include "vertex.glsl"
+
 layout(location = 0) in vec3 in_position;
 layout(location = 1) in vec3 in_normal;
 layout(location = 2) in vec4 in_color;
@@ -9,7 +11,10 @@ out vec3 g_normal;
 out vec4 g_color;
 
 void main(void) {
-    g_position = in_position;
-    g_normal = in_normal;
+    vec3 position = instancePosition(in_position);
+    vec3 normal = instanceNormal(in_normal);
+
+    g_position = position;
+    g_normal = normal;
     g_color = in_color;
 }
@@ -0,0 +1,58 @@
+// One bounce of indirect light gathered from the RSM around the point's
+// projection into the light's view. Needs rsmsample.glsl.
+
+#define RSM_MAX_SAMPLES 1024
+
+// Disc kernel built by RsmTechnique: xy is the offset in atlas
+// coordinates, z the weight that undoes the radial sample density and w
+// the RSM mip level to read it from (0 is the RSM itself)
+layout(std140) uniform RsmKernel {
+    vec4 u_kernel[RSM_MAX_SAMPLES];
+};
+
+uniform int u_nSamples;
+
+// Turns the kernel by a new angle every frame in temporal mode
+uniform mat2 u_sampleRotation;
+
+#ifdef RSM_HIERARCHY
+// Flux-weighted 4x3 atlas at half the RSM resolution and below (rsmmip.fs)
+uniform sampler2D u_mipPosition;
+uniform sampler2D u_mipNormal;
+uniform sampler2D u_mipFlux;
+#endif
+
+const float Pi = 4.0 * atan(1.0);
+
+vec3 rsmIndirect(vec3 posWorld, vec3 nrmWorld, vec3 lightPos) {
+    vec2 uvLightSpace = rsmLightCoord(posWorld, lightPos);
+    vec3 N = normalize(nrmWorld);
+
+    vec3 indirect = vec3(0.0, 0.0, 0.0);
+    for (int i = 0; i < u_nSamples; i++) {
+        vec4 k = u_kernel[i];
+        vec2 uv = uvLightSpace + u_sampleRotation * k.xy;
+
+        vec3 pos, nrm, diff;
+#ifdef RSM_HIERARCHY
+        // Samples far out are sparse and read merged pixel lights
+        if (k.w > 0.0) {
+            pos = textureLod(u_mipPosition, uv, k.w - 1.0).xyz;
+            nrm = textureLod(u_mipNormal, uv, k.w - 1.0).xyz;
+            diff = textureLod(u_mipFlux, uv, k.w - 1.0).rgb;
+        } else
+#endif
+        {
+            pos = rsmPosition(uv);
+            nrm = rsmNormal(uv);
+            diff = rsmFlux(uv);
+        }
+
+        float dot1 = max(0.0, dot(pos - posWorld, N));
+        float dot2 = max(0.0, -dot(posWorld - pos, nrm));
+        float dist = length(pos - posWorld);
+
+        indirect += k.z * diff * (dot1 * dot2) / (dist * dist * dist * dist);
+    }
+    return 4.0 * Pi * indirect / u_nSamples;
+}
@@ -0,0 +1,61 @@
+#version 330
+
+// One level of the RSM gather hierarchy: each texel merges 2x2 texels of
+// the level below into a single pixel light. Flux is averaged, so a
+// coarse sample stands for the same area density as a fine one, while
+// position and normal are weighted by the luminance of the flux so that
+// dark texels do not drag the light off the lit surface.
+//
+// RSM_MIP_BASE reads the RSM itself (any layout and format) and writes the
+// first level at half its resolution; otherwise the single level exposed
+// by the source textures is halved.
+
+layout(location = 0) out vec4 out_position;
+layout(location = 1) out vec4 out_normal;
+layout(location = 2) out vec4 out_flux;
+
+#ifdef RSM_MIP_BASE
+#include "rsmsample.glsl"
+
+uniform vec2 u_rsmSize;
+#else
+uniform sampler2D u_mipPosition;
+uniform sampler2D u_mipNormal;
+uniform sampler2D u_mipFlux;
+#endif
+
+void main(void) {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+
+    vec3 position = vec3(0.0, 0.0, 0.0);
+    vec3 normal = vec3(0.0, 0.0, 0.0);
+    vec3 flux = vec3(0.0, 0.0, 0.0);
+    float weightSum = 0.0;
+    for (int i = 0; i < 4; i++) {
+        ivec2 child = texel * 2 + ivec2(i & 1, i >> 1);
+#ifdef RSM_MIP_BASE
+        vec2 uv = (vec2(child) + 0.5) / u_rsmSize;
+        vec3 p = rsmPosition(uv);
+        vec3 n = rsmNormal(uv);
+        vec3 f = rsmFlux(uv);
+#else
+        vec3 p = texelFetch(u_mipPosition, child, 0).xyz;
+        vec3 n = texelFetch(u_mipNormal, child, 0).xyz;
+        vec3 f = texelFetch(u_mipFlux, child, 0).rgb;
+#endif
+
+        // Unlit texels still count a little, for an all-dark block
+        float w = dot(f, vec3(0.2126, 0.7152, 0.0722)) + 1.0e-4;
+        position += w * p;
+        normal += w * n;
+        flux += f;
+        weightSum += w;
+    }
+
+    // A zero normal marks a block without a surface facing one way; the
+    // gather then gets no light from it
+    float len = length(normal);
+    out_position = vec4(position / weightSum, 1.0);
+    out_normal = vec4(len > 1.0e-6 ? normal / len : vec3(0.0), 0.0);
+    out_flux = vec4(flux * 0.25, 1.0);
+}
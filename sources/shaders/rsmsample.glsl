@@ -0,0 +1,125 @@
+// RSM lookups shared by the passes that read the reflective shadow map.
+// RSM_COMPACT selects the packed layout (see rsmformat.h). SHADOW_ONLY
+// passes bind nothing but the depth texture and only use rsmDepth().
+//
+// Lookups always take coordinates in the 4x3 atlas. With RSM_LAYERED the
+// maps are 2D arrays with one layer per cube face, and the atlas cell is
+// translated to a layer here.
+
+#include "packing.glsl"
+
+#ifdef RSM_LAYERED
+#define RSM_SAMPLER sampler2DArray
+#else
+#define RSM_SAMPLER sampler2D
+#endif
+
+uniform RSM_SAMPLER u_depthMap;
+uniform RSM_SAMPLER u_positionMap;
+uniform RSM_SAMPLER u_normalMap;
+uniform RSM_SAMPLER u_diffuseMap;
+
+uniform mat4 u_lightVpMat[6];
+uniform mat4 u_lightInvVpMat[6];
+
+const int rsmCubeX[6] = int[6]( 0, 2, 1, 1, 1, 3 );
+const int rsmCubeY[6] = int[6]( 1, 1, 0, 2, 1, 1 );
+
+// Cube face of an atlas coordinate, -1 for the unused cells
+int rsmFace(vec2 uv, out vec2 local) {
+    vec2 cell = uv * vec2(4.0, 3.0);
+    ivec2 c = ivec2(floor(cell));
+    local = fract(cell);
+
+    int face = -1;
+    for (int i = 0; i < 6; i++) {
+        if (rsmCubeX[i] == c.x && 2 - rsmCubeY[i] == c.y) {
+            face = i;
+        }
+    }
+    return face;
+}
+
+// Atlas coordinate of a position inside a face
+vec2 rsmAtlasCoord(int face, vec2 local) {
+    vec2 cell = vec2(rsmCubeX[face], 2 - rsmCubeY[face]);
+    return (cell + clamp(local, 0.0, 0.9995)) / vec2(4.0, 3.0);
+}
+
+// Face looking along the major axis of dir, in the order of the light's
+// view matrices (-X, +X, -Y, +Y, -Z, +Z)
+int rsmFaceOf(vec3 dir) {
+    vec3 a = abs(dir);
+    int axis = a.x >= a.y && a.x >= a.z ? 0 : (a.y >= a.z ? 1 : 2);
+    return 2 * axis + (dir[axis] > 0.0 ? 1 : 0);
+}
+
+// "outside" is what the cleared atlas holds in the unused cells
+vec4 rsmTexture(RSM_SAMPLER map, vec2 uv, vec4 outside) {
+#ifdef RSM_LAYERED
+    vec2 local;
+    int face = rsmFace(uv, local);
+    if (face < 0) {
+        return outside;
+    }
+    return texture(map, vec3(local, float(face)));
+#else
+    return texture(map, uv);
+#endif
+}
+
+// Depth in NDC [-1, 1]
+float rsmDepth(vec2 uv) {
+#if defined(RSM_COMPACT) || defined(SHADOW_ONLY)
+    return rsmTexture(u_depthMap, uv, vec4(1.0)).x * 2.0 - 1.0;
+#else
+    return rsmTexture(u_depthMap, uv, vec4(1.0)).x;
+#endif
+}
+
+vec3 rsmPosition(vec2 uv) {
+#ifdef RSM_COMPACT
+    vec2 local;
+    int face = rsmFace(uv, local);
+    if (face < 0) {
+        return vec3(0.0, 0.0, 0.0);
+    }
+
+    vec4 pos = u_lightInvVpMat[face] * vec4(local * 2.0 - 1.0, rsmDepth(uv), 1.0);
+    return pos.xyz / pos.w;
+#else
+    return rsmTexture(u_positionMap, uv, vec4(0.0)).xyz;
+#endif
+}
+
+vec3 rsmNormal(vec2 uv) {
+#ifdef RSM_COMPACT
+    return decodeOctahedral(rsmTexture(u_normalMap, uv, vec4(0.0)).xy);
+#else
+    return normalize(rsmTexture(u_normalMap, uv, vec4(0.0)).xyz * 2.0 - 1.0);
+#endif
+}
+
+vec3 rsmFlux(vec2 uv) {
+    return rsmTexture(u_diffuseMap, uv, vec4(0.0)).rgb;
+}
+
+// Atlas coordinate of a world position seen from the light
+vec2 rsmLightCoord(vec3 posWorld, vec3 lightPos) {
+    int face = rsmFaceOf(posWorld - lightPos);
+    vec4 p = u_lightVpMat[face] * vec4(posWorld, 1.0);
+    return rsmAtlasCoord(face, p.xy / p.w * 0.5 + 0.5);
+}
+
+// Distance from the light to the closest surface in the direction of
+// posWorld. Comparing distances keeps the shadow bias in world units,
+// independent of the non-linear perspective depth.
+float rsmOccluderDistance(vec3 posWorld, vec3 lightPos) {
+    int face = rsmFaceOf(posWorld - lightPos);
+    vec4 p = u_lightVpMat[face] * vec4(posWorld, 1.0);
+    vec2 ndc = p.xy / p.w;
+    float depth = rsmDepth(rsmAtlasCoord(face, ndc * 0.5 + 0.5));
+
+    vec4 q = u_lightInvVpMat[face] * vec4(ndc, depth, 1.0);
+    return length(q.xyz / q.w - lightPos);
+}
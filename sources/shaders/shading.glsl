@@ -0,0 +1,37 @@
+// Direct light, shadow and the indirect term of the technique, shared by
+// the forward (render.fs) and deferred (deferred.fs) scene passes. Needs
+// rsmsample.glsl, rsmgather.glsl and upsample.glsl.
+//
+// SHADOW_ONLY:       no indirect light
+// ISM_INDIRECT:      full-resolution result of the ISM lighting passes
+// INDIRECT_UPSAMPLE: reduced-resolution result of indirect.fs
+// otherwise:         RSM gather for this pixel
+
+const float shadowBias = 0.05;
+
+vec3 shade(vec3 posWorld, vec3 nrmWorld, vec3 color, float depthView, vec3 lightPos) {
+    // Indirect illumination
+#if defined(SHADOW_ONLY)
+    vec3 indirect = vec3(0.0, 0.0, 0.0);
+#elif defined(ISM_INDIRECT)
+    vec3 indirect = texelFetch(u_indirectMap, ivec2(gl_FragCoord.xy), 0).rgb;
+#elif defined(INDIRECT_UPSAMPLE)
+    vec3 indirect = upsampleIndirect(nrmWorld, depthView);
+#else
+    vec3 indirect = rsmIndirect(posWorld, nrmWorld, lightPos);
+#endif
+
+    // Shadow
+    float visibility = 1.0;
+    float distance = length(posWorld - lightPos);
+    if (rsmOccluderDistance(posWorld, lightPos) < distance - shadowBias) {
+        visibility = 0.5;
+    }
+
+    // Direct illumination
+    vec3 N = normalize(nrmWorld);
+    vec3 L = normalize(lightPos - posWorld);
+
+    float ndotl = max(0.0, dot(N, L));
+    return visibility * (color * ndotl + color * indirect);
+}
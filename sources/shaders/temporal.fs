@@ -0,0 +1,75 @@
+#version 330
+
+// Temporal accumulation of the gathered indirect light. Each texel is
+// reprojected into the previous frame through the camera matrices and
+// blended with the history there, unless the surface it finds differs in
+// depth or orientation (disocclusion). Alpha counts the frames in the
+// history, which is weighted as their mean up to u_maxHistory frames.
+
+uniform sampler2D u_indirectMap;
+uniform sampler2D u_indirectGeometry;
+uniform sampler2D u_historyMap;
+uniform sampler2D u_historyGeometry;
+
+uniform mat4 u_invVpMat;
+uniform mat4 u_mvMat;
+uniform mat4 u_prevVpMat;
+uniform mat4 u_prevMvMat;
+
+uniform bool u_historyValid;
+uniform float u_maxHistory;
+
+const float historyDepthTolerance = 0.05;  // relative view depth
+const float historyNormalTolerance = 0.9;  // cosine
+
+out vec4 out_color;
+
+// World position on the view ray through uv at the given view depth,
+// which is linear along the ray
+vec3 viewRayPosition(vec2 uv, float depthView) {
+    vec2 ndc = uv * 2.0 - 1.0;
+    vec4 near = u_invVpMat * vec4(ndc, -1.0, 1.0);
+    vec4 far = u_invVpMat * vec4(ndc, 1.0, 1.0);
+    near /= near.w;
+    far /= far.w;
+
+    float depthNear = -(u_mvMat * vec4(near.xyz, 1.0)).z;
+    float depthFar = -(u_mvMat * vec4(far.xyz, 1.0)).z;
+    return mix(near.xyz, far.xyz, (depthView - depthNear) / (depthFar - depthNear));
+}
+
+void main(void) {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec2 size = vec2(textureSize(u_indirectMap, 0));
+    vec3 current = texelFetch(u_indirectMap, texel, 0).rgb;
+    vec4 geometry = texelFetch(u_indirectGeometry, texel, 0);
+    if (geometry.w <= 0.0) {
+        out_color = vec4(0.0);
+        return;
+    }
+
+    float frames = 1.0;
+    vec3 history = vec3(0.0, 0.0, 0.0);
+    if (u_historyValid) {
+        vec3 posWorld = viewRayPosition(gl_FragCoord.xy / size, geometry.w);
+        vec4 prevClip = u_prevVpMat * vec4(posWorld, 1.0);
+        vec2 prevUv = prevClip.xy / prevClip.w * 0.5 + 0.5;
+
+        if (prevClip.w > 0.0 && all(greaterThanEqual(prevUv, vec2(0.0))) && all(lessThan(prevUv, vec2(1.0)))) {
+            ivec2 prevTexel = ivec2(prevUv * size);
+            vec4 prevGeometry = texelFetch(u_historyGeometry, prevTexel, 0);
+            float prevDepth = -(u_prevMvMat * vec4(posWorld, 1.0)).z;
+
+            bool sameSurface = prevGeometry.w > 0.0 &&
+                abs(prevGeometry.w - prevDepth) < historyDepthTolerance * prevDepth &&
+                dot(prevGeometry.xyz, geometry.xyz) > historyNormalTolerance;
+            if (sameSurface) {
+                vec4 prev = texelFetch(u_historyMap, prevTexel, 0);
+                history = prev.rgb;
+                frames = min(prev.a + 1.0, u_maxHistory);
+            }
+        }
+    }
+
+    out_color = vec4(mix(history, current, 1.0 / frames), frames);
+}
@@ -0,0 +1,53 @@
+// Joint bilateral upsampling of the reduced-resolution indirect light
+// written by indirect.fs. The four nearest low-resolution texels are
+// weighted bilinearly and by how well their normal and view depth match
+// the full-resolution pixel, so light does not bleed across silhouettes.
+
+uniform sampler2D u_indirectMap;
+uniform sampler2D u_indirectGeometry;
+
+// Low-resolution size divided by the full-resolution size
+uniform vec2 u_indirectRatio;
+
+const float upsampleDepthSigma = 0.05;  // relative view depth
+const float upsampleNormalPower = 16.0;
+
+vec3 upsampleIndirect(vec3 nrmWorld, float depthView) {
+    vec2 p = gl_FragCoord.xy * u_indirectRatio - 0.5;
+    ivec2 base = ivec2(floor(p));
+    vec2 f = p - vec2(base);
+    ivec2 size = textureSize(u_indirectMap, 0);
+    vec3 N = normalize(nrmWorld);
+
+    vec3 sum = vec3(0.0, 0.0, 0.0);
+    float weightSum = 0.0;
+    ivec2 closest = clamp(base, ivec2(0), size - 1);
+    float closestDiff = 1.0e20;
+    for (int i = 0; i < 4; i++) {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 texel = clamp(base + offset, ivec2(0), size - 1);
+        vec4 geometry = texelFetch(u_indirectGeometry, texel, 0);
+        if (geometry.w <= 0.0) continue;
+
+        float depthDiff = abs(geometry.w - depthView) / depthView;
+        if (depthDiff < closestDiff) {
+            closestDiff = depthDiff;
+            closest = texel;
+        }
+
+        vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+        float wz = exp(-depthDiff * depthDiff / (upsampleDepthSigma * upsampleDepthSigma));
+        float wn = pow(max(0.0, dot(N, geometry.xyz)), upsampleNormalPower);
+        float w = bilinear.x * bilinear.y * wz * wn;
+
+        sum += w * texelFetch(u_indirectMap, texel, 0).rgb;
+        weightSum += w;
+    }
+
+    // No texel lies on the same surface, e.g. a thin feature that the low
+    // resolution missed: take the one closest in depth
+    if (weightSum < 1.0e-4) {
+        return texelFetch(u_indirectMap, closest, 0).rgb;
+    }
+    return sum / weightSum;
+}
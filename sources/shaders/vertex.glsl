@@ -0,0 +1,20 @@
+// Position decode of the vertex layout (see VertexFormat). Float layouts
+// use a zero offset and unit scale.
+uniform vec3 u_positionOffset;
+uniform vec3 u_positionScale;
+
+vec3 decodePosition(vec3 p) {
+    return u_positionOffset + u_positionScale * p;
+}
+
+// Model matrix of the instance, one per drawn copy of the mesh. Instances
+// are rigid transforms with a uniform scale.
+layout(location = 3) in mat4 in_instanceMat;
+
+vec3 instancePosition(vec3 p) {
+    return (in_instanceMat * vec4(decodePosition(p), 1.0)).xyz;
+}
+
+vec3 instanceNormal(vec3 n) {
+    return mat3(in_instanceMat) * n / length(in_instanceMat[0].xyz);
+}
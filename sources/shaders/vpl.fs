@@ -0,0 +1,35 @@
+#version 330
+
+#include "rsmsample.glsl"
+
+uniform int u_ismCols;
+
+layout(location = 0) out vec4 out_position;
+layout(location = 1) out vec4 out_normal;
+layout(location = 2) out vec4 out_flux;
+
+float radicalInverse(int base, int i) {
+    float inv = 1.0 / float(base);
+    float f = inv;
+    float r = 0.0;
+    while (i > 0) {
+        r += f * float(i % base);
+        i /= base;
+        f *= inv;
+    }
+    return r;
+}
+
+// One VPL per texel, distributed over the six cube faces of the RSM with
+// a Halton sequence inside each face.
+void main(void) {
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    int index = p.y * u_ismCols + p.x;
+    int face = index % 6;
+    vec2 local = vec2(radicalInverse(2, index / 6 + 1), radicalInverse(3, index / 6 + 1));
+    vec2 uv = rsmAtlasCoord(face, local);
+
+    out_position = vec4(rsmPosition(uv), 1.0);
+    out_normal = vec4(rsmNormal(uv), 0.0);
+    out_flux = vec4(rsmFlux(uv), 1.0);
+}
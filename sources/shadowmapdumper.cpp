@@ -0,0 +1,381 @@
+#include "shadowmapdumper.h"
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+#include <QtCore/qrunnable.h>
+#include <QtCore/qthread.h>
+#include <QtGui/qimage.h>
+
+#include "common.h"
+#include "glutils.h"
+
+namespace {
+
+bool isLittleEndian() {
+    const uint16_t value = 1;
+    return *reinterpret_cast<const uint8_t*>(&value) == 1;
+}
+
+template <typename T>
+void writeLE(std::ofstream &ofs, T value) {
+    uint8_t bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    if (!isLittleEndian()) {
+        std::reverse(bytes, bytes + sizeof(T));
+    }
+    ofs.write(reinterpret_cast<const char*>(bytes), sizeof(T));
+}
+
+void writeAttribute(std::ofstream &ofs, const char *name, const char *type, int32_t size) {
+    ofs.write(name, std::strlen(name) + 1);
+    ofs.write(type, std::strlen(type) + 1);
+    writeLE<int32_t>(ofs, size);
+}
+
+// Pixels are stored bottom-up as they come from glReadPixels.
+bool savePNG(const std::string &path, const std::vector<float> &data,
+             int width, int height, int components) {
+    QImage image(width, height, QImage::Format_RGBA8888);
+    for (int y = 0; y < height; y++) {
+        const float *src = &data[(size_t)(height - 1 - y) * width * components];
+        uchar *dst = image.scanLine(y);
+        for (int x = 0; x < width; x++) {
+            float rgba[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+            if (components == 1) {
+                rgba[0] = rgba[1] = rgba[2] = src[x];
+            } else {
+                for (int c = 0; c < components; c++) {
+                    rgba[c] = src[x * components + c];
+                }
+            }
+            for (int c = 0; c < 4; c++) {
+                dst[x * 4 + c] = (uchar)(std::max(0.0f, std::min(rgba[c], 1.0f)) * 255.0f + 0.5f);
+            }
+        }
+    }
+    return image.save(QString::fromStdString(path));
+}
+
+// Portable float map. Only grayscale and RGB exist, so two-channel data
+// is padded with zero blue and alpha is dropped.
+bool savePFM(const std::string &path, const std::vector<float> &data,
+             int width, int height, int components) {
+    std::ofstream ofs(path.c_str(), std::ios::out | std::ios::binary);
+    if (!ofs.is_open()) {
+        return false;
+    }
+
+    const int channels = components == 1 ? 1 : 3;
+    ofs << (channels == 1 ? "Pf" : "PF") << "\n";
+    ofs << width << " " << height << "\n";
+    ofs << (isLittleEndian() ? "-1.0" : "1.0") << "\n";
+
+    std::vector<float> row((size_t)width * channels, 0.0f);
+    for (int y = 0; y < height; y++) {
+        const float *src = &data[(size_t)y * width * components];
+        for (int x = 0; x < width; x++) {
+            for (int c = 0; c < std::min(channels, components); c++) {
+                row[x * channels + c] = src[x * components + c];
+            }
+        }
+        ofs.write(reinterpret_cast<const char*>(&row[0]), row.size() * sizeof(float));
+    }
+    return ofs.good();
+}
+
+// Minimal uncompressed scanline OpenEXR writer with FLOAT channels.
+bool saveEXR(const std::string &path, const std::vector<float> &data,
+             int width, int height, int components) {
+    std::ofstream ofs(path.c_str(), std::ios::out | std::ios::binary);
+    if (!ofs.is_open()) {
+        return false;
+    }
+
+    // Channels must be listed (and stored) in alphabetical order.
+    static const char *names[4][4] = {
+        { "Y" }, { "G", "R" }, { "B", "G", "R" }, { "A", "B", "G", "R" }
+    };
+    static const int source[4][4] = {
+        { 0 }, { 1, 0 }, { 2, 1, 0 }, { 3, 2, 1, 0 }
+    };
+    const char * const *chNames = names[components - 1];
+    const int *chSource = source[components - 1];
+
+    writeLE<uint32_t>(ofs, 20000630);
+    writeLE<uint32_t>(ofs, 2);
+
+    int32_t chlistSize = 1;
+    for (int c = 0; c < components; c++) {
+        chlistSize += (int32_t)std::strlen(chNames[c]) + 1 + 16;
+    }
+    writeAttribute(ofs, "channels", "chlist", chlistSize);
+    for (int c = 0; c < components; c++) {
+        ofs.write(chNames[c], std::strlen(chNames[c]) + 1);
+        writeLE<int32_t>(ofs, 2);  // FLOAT
+        writeLE<uint32_t>(ofs, 0); // pLinear + reserved
+        writeLE<int32_t>(ofs, 1);
+        writeLE<int32_t>(ofs, 1);
+    }
+    ofs.put(0);
+
+    writeAttribute(ofs, "compression", "compression", 1);
+    ofs.put(0);
+
+    for (const char *window : { "dataWindow", "displayWindow" }) {
+        writeAttribute(ofs, window, "box2i", 16);
+        writeLE<int32_t>(ofs, 0);
+        writeLE<int32_t>(ofs, 0);
+        writeLE<int32_t>(ofs, width - 1);
+        writeLE<int32_t>(ofs, height - 1);
+    }
+
+    writeAttribute(ofs, "lineOrder", "lineOrder", 1);
+    ofs.put(0);
+    writeAttribute(ofs, "pixelAspectRatio", "float", 4);
+    writeLE<float>(ofs, 1.0f);
+    writeAttribute(ofs, "screenWindowCenter", "v2f", 8);
+    writeLE<float>(ofs, 0.0f);
+    writeLE<float>(ofs, 0.0f);
+    writeAttribute(ofs, "screenWindowWidth", "float", 4);
+    writeLE<float>(ofs, 1.0f);
+    ofs.put(0);
+
+    const uint64_t lineBytes = (uint64_t)width * components * sizeof(float);
+    const uint64_t tableEnd = (uint64_t)ofs.tellp() + (uint64_t)height * sizeof(uint64_t);
+    for (int y = 0; y < height; y++) {
+        writeLE<uint64_t>(ofs, tableEnd + (uint64_t)y * (8 + lineBytes));
+    }
+
+    // EXR scanlines go top-down.
+    for (int y = 0; y < height; y++) {
+        const float *src = &data[(size_t)(height - 1 - y) * width * components];
+        writeLE<int32_t>(ofs, y);
+        writeLE<int32_t>(ofs, (int32_t)lineBytes);
+        for (int c = 0; c < components; c++) {
+            for (int x = 0; x < width; x++) {
+                writeLE<float>(ofs, src[x * components + chSource[c]]);
+            }
+        }
+    }
+    return ofs.good();
+}
+
+class DumpTask : public QRunnable {
+public:
+    DumpTask(std::string path, std::vector<float> &&data,
+             int width, int height, int components, DumpFormat format)
+        : path_(std::move(path))
+        , data_(std::move(data))
+        , width_(width)
+        , height_(height)
+        , components_(components)
+        , format_(format) {
+    }
+
+    void run() override {
+        bool success = false;
+        switch (format_) {
+        case DumpFormat::PNG:
+            success = savePNG(path_, data_, width_, height_, components_);
+            break;
+
+        case DumpFormat::PFM:
+            success = savePFM(path_, data_, width_, height_, components_);
+            break;
+
+        case DumpFormat::EXR:
+            success = saveEXR(path_, data_, width_, height_, components_);
+            break;
+        }
+
+        if (!success) {
+            std::cerr << "[ERROR] failed to save shadow map dump: " << path_ << std::endl;
+        }
+    }
+
+private:
+    std::string path_;
+    std::vector<float> data_;
+    int width_, height_, components_;
+    DumpFormat format_;
+};
+
+int componentsOf(GLenum format) {
+    switch (format) {
+    case GL_RG:   return 2;
+    case GL_RGB:  return 3;
+    case GL_RGBA: return 4;
+    default:      return 1;
+    }
+}
+
+const char *extensionOf(DumpFormat format) {
+    switch (format) {
+    case DumpFormat::PFM: return "pfm";
+    case DumpFormat::EXR: return "exr";
+    default:              return "png";
+    }
+}
+
+}  // anonymous namespace
+
+ShadowMapDumper::ShadowMapDumper() {
+    workers_.setMaxThreadCount(std::max(1, QThread::idealThreadCount() / 2));
+}
+
+ShadowMapDumper::~ShadowMapDumper() {
+    workers_.waitForDone();
+}
+
+void ShadowMapDumper::request(DumpFormat format) {
+    requested_ = true;
+    format_ = format;
+}
+
+void ShadowMapDumper::capture(GLuint fbo, int width, int height, const std::vector<DumpChannel> &channels) {
+    auto f = glCoreFunctions();
+
+    GLint prevReadFbo = 0;
+    f->glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &prevReadFbo);
+    f->glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    f->glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+    Batch batch;
+    batch.width = width;
+    batch.height = height;
+    batch.index = dumpIndex_++;
+    batch.format = format_;
+
+    for (const auto &ch : channels) {
+        Readback rb;
+        rb.name = ch.name;
+        rb.components = componentsOf(ch.format);
+        rb.bytes = (size_t)width * height * rb.components * sizeof(float);
+        rb.pbo = acquireBuffer(f, rb.bytes);
+
+        if (ch.layer >= 0) {
+            bindLayer(f, ch);
+        } else if (ch.attachment != GL_DEPTH_ATTACHMENT) {
+            f->glReadBuffer(ch.attachment);
+        }
+        f->glBindBuffer(GL_PIXEL_PACK_BUFFER, rb.pbo);
+        f->glReadPixels(0, 0, width, height, ch.format, GL_FLOAT, nullptr);
+        batch.readbacks.push_back(rb);
+
+        if (ch.layer >= 0) {
+            f->glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+        }
+    }
+    f->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    f->glBindFramebuffer(GL_READ_FRAMEBUFFER, prevReadFbo);
+
+    batch.fence = f->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    pending_.push_back(batch);
+    requested_ = false;
+}
+
+void ShadowMapDumper::poll() {
+    if (pending_.empty()) return;
+
+    auto f = glCoreFunctions();
+    auto it = pending_.begin();
+    while (it != pending_.end()) {
+        const GLenum status = f->glClientWaitSync(it->fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED) {
+            ++it;
+            continue;
+        }
+
+        if (status == GL_WAIT_FAILED) {
+            std::cerr << "[ERROR] shadow map readback fence failed" << std::endl;
+        }
+        f->glDeleteSync(it->fence);
+
+        for (const auto &rb : it->readbacks) {
+            f->glBindBuffer(GL_PIXEL_PACK_BUFFER, rb.pbo);
+            const void *mapped = f->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, rb.bytes, GL_MAP_READ_BIT);
+            if (mapped && status != GL_WAIT_FAILED) {
+                std::vector<float> data(rb.bytes / sizeof(float));
+                std::memcpy(&data[0], mapped, rb.bytes);
+                char suffix[16];
+                std::snprintf(suffix, sizeof(suffix), "_%04d.", it->index);
+                const std::string path = std::string(OUTPUT_DIRECTORY) + rb.name + suffix + extensionOf(it->format);
+                workers_.start(new DumpTask(path, std::move(data), it->width, it->height, rb.components, it->format));
+            }
+            if (mapped) {
+                f->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+            freeBuffers_.emplace_back(rb.pbo, rb.bytes);
+        }
+        f->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        it = pending_.erase(it);
+    }
+}
+
+void ShadowMapDumper::release() {
+    if (pending_.empty() && freeBuffers_.empty() && layerFbo_ == 0) return;
+
+    auto f = glCoreFunctions();
+    if (layerFbo_) {
+        f->glDeleteFramebuffers(1, &layerFbo_);
+        layerFbo_ = 0;
+    }
+
+    for (const auto &batch : pending_) {
+        f->glDeleteSync(batch.fence);
+        for (const auto &rb : batch.readbacks) {
+            f->glDeleteBuffers(1, &rb.pbo);
+        }
+    }
+    pending_.clear();
+
+    for (const auto &buf : freeBuffers_) {
+        f->glDeleteBuffers(1, &buf.first);
+    }
+    freeBuffers_.clear();
+}
+
+// glReadPixels only sees the first layer of a layered attachment, so the
+// requested layer is attached alone to a scratch framebuffer.
+void ShadowMapDumper::bindLayer(QOpenGLFunctions_3_3_Core *f, const DumpChannel &ch) {
+    GLint texture = 0;
+    f->glGetFramebufferAttachmentParameteriv(GL_READ_FRAMEBUFFER, ch.attachment,
+                                             GL_FRAMEBUFFER_ATTACHMENT_OBJECT_NAME, &texture);
+
+    if (layerFbo_ == 0) {
+        f->glGenFramebuffers(1, &layerFbo_);
+    }
+    f->glBindFramebuffer(GL_READ_FRAMEBUFFER, layerFbo_);
+    f->glFramebufferTexture(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, 0, 0);
+    f->glFramebufferTexture(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, 0, 0);
+
+    if (ch.attachment == GL_DEPTH_ATTACHMENT) {
+        f->glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, ch.layer);
+        f->glReadBuffer(GL_NONE);
+    } else {
+        f->glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture, 0, ch.layer);
+        f->glReadBuffer(GL_COLOR_ATTACHMENT0);
+    }
+}
+
+GLuint ShadowMapDumper::acquireBuffer(QOpenGLFunctions_3_3_Core *f, size_t bytes) {
+    for (auto it = freeBuffers_.begin(); it != freeBuffers_.end(); ++it) {
+        if (it->second == bytes) {
+            const GLuint pbo = it->first;
+            freeBuffers_.erase(it);
+            return pbo;
+        }
+    }
+
+    GLuint pbo = 0;
+    f->glGenBuffers(1, &pbo);
+    f->glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+    f->glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+    f->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return pbo;
+}
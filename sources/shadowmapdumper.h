@@ -0,0 +1,77 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _SHADOWMAP_DUMPER_H_
+#define _SHADOWMAP_DUMPER_H_
+
+#include <string>
+#include <vector>
+
+#include <QtCore/qthreadpool.h>
+#include <QtGui/qopenglfunctions_3_3_core.h>
+
+enum class DumpFormat : int {
+    PNG = 0x01,
+    PFM = 0x02,
+    EXR = 0x04
+};
+
+// One attachment of a framebuffer to be written to disk.
+// "format" is the pixel transfer format (GL_RED, GL_RG, GL_RGBA or
+// GL_DEPTH_COMPONENT). Pixels are always read back as 32-bit floats.
+// "layer" selects one layer of a layered attachment, -1 for plain ones.
+struct DumpChannel {
+    std::string name;
+    GLenum attachment;
+    GLenum format;
+    int layer = -1;
+};
+
+// Debug capture of shadow map attachments. A capture is only issued after
+// request() is called. Readbacks go into pixel-buffer objects guarded by a
+// fence, and encoding runs on a worker pool, so rendering never waits.
+class ShadowMapDumper {
+public:
+    explicit ShadowMapDumper();
+    virtual ~ShadowMapDumper();
+
+    void request(DumpFormat format);
+    void capture(GLuint fbo, int width, int height, const std::vector<DumpChannel> &channels);
+    void poll();
+    void release();
+
+    inline bool isRequested() const { return requested_; }
+    inline bool hasPending() const { return !pending_.empty(); }
+
+private:
+    struct Readback {
+        std::string name;
+        GLuint pbo;
+        size_t bytes;
+        int components;
+    };
+
+    struct Batch {
+        std::vector<Readback> readbacks;
+        GLsync fence;
+        int width;
+        int height;
+        int index;
+        DumpFormat format;
+    };
+
+    GLuint acquireBuffer(QOpenGLFunctions_3_3_Core *f, size_t bytes);
+    void bindLayer(QOpenGLFunctions_3_3_Core *f, const DumpChannel &ch);
+
+    bool requested_ = false;
+    DumpFormat format_ = DumpFormat::PNG;
+    int dumpIndex_ = 0;
+
+    std::vector<Batch> pending_;
+    std::vector<std::pair<GLuint, size_t>> freeBuffers_;
+    GLuint layerFbo_ = 0;
+    QThreadPool workers_;
+};
+
+#endif  // _SHADOWMAP_DUMPER_H_
@@ -0,0 +1,202 @@
+#include "shadowtechnique.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "common.h"
+#include "glutils.h"
+
+namespace {
+
+// Face order shared with rsmFaceOf() in rsmsample.glsl
+const QVector3D cubeAxes[6] = {
+    QVector3D(-1.0f,  0.0f,  0.0f),
+    QVector3D( 1.0f,  0.0f,  0.0f),
+    QVector3D( 0.0f, -1.0f,  0.0f),
+    QVector3D( 0.0f,  1.0f,  0.0f),
+    QVector3D( 0.0f,  0.0f, -1.0f),
+    QVector3D( 0.0f,  0.0f,  1.0f)
+};
+
+}  // anonymous namespace
+
+void LightCube::setup(const QVector3D &pos, const QVector3D &bboxMin, const QVector3D &bboxMax, float minNear) {
+    position = pos;
+
+    // Far plane reaches the farthest corner of the box, near plane the
+    // closest point of it when the light is outside.
+    float maxDist = 0.0f;
+    for (int i = 0; i < 8; i++) {
+        const QVector3D corner((i & 1) ? bboxMax.x() : bboxMin.x(),
+                               (i & 2) ? bboxMax.y() : bboxMin.y(),
+                               (i & 4) ? bboxMax.z() : bboxMin.z());
+        maxDist = std::max(maxDist, (corner - pos).length());
+    }
+    const QVector3D closest(std::min(std::max(pos.x(), bboxMin.x()), bboxMax.x()),
+                            std::min(std::max(pos.y(), bboxMin.y()), bboxMax.y()),
+                            std::min(std::max(pos.z(), bboxMin.z()), bboxMax.z()));
+    nearPlane = std::max(minNear, 0.9f * (closest - pos).length());
+    farPlane = std::max(nearPlane * 2.0f, maxDist * 1.01f);
+
+    projMat.setToIdentity();
+    projMat.perspective(90.0f, 1.0f, nearPlane, farPlane);
+
+    viewMat.resize(6);
+    for (int i = 0; i < 6; i++) {
+        QVector3D up(0.0f, 1.0f, 0.0f);
+        if (QVector3D::crossProduct(cubeAxes[i], up).length() < 0.01f) {
+            up = QVector3D(1.0f, 0.0f, 0.0f);
+        }
+        viewMat[i].setToIdentity();
+        viewMat[i].lookAt(pos, pos + cubeAxes[i], up);
+    }
+}
+
+void ShadowTechnique::setSceneUniforms(QOpenGLShaderProgram &program, const RenderContext &ctx) {
+    program.setUniformValue("u_mvMat", ctx.camera->mvMat());
+    program.setUniformValue("u_mvpMat", ctx.camera->mvpMat());
+    program.setUniformValue("u_lightPos", ctx.light.position);
+    program.setUniformValueArray("u_lightVpMat", &ctx.light.vpMat()[0], 6);
+    program.setUniformValueArray("u_lightInvVpMat", &ctx.light.invVpMat()[0], 6);
+}
+
+void ShadowTechnique::drawFullScreen(const RenderContext &ctx) {
+    ctx.emptyVao->bind();
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    ctx.emptyVao->release();
+}
+
+RenderTargetDesc ShadowTechnique::shadowMapDesc(const RenderContext &ctx, GLenum internalFormat) const {
+    const int size = ctx.settings.shadowMapSize;
+    if (ctx.settings.layout == ShadowMapLayout::Layered) {
+        return RenderTargetDesc::texture2DArray(size, size, 6, internalFormat);
+    }
+    return RenderTargetDesc::texture2D(size * 4, size * 3, internalFormat);
+}
+
+void ShadowTechnique::captureShadowMap(const RenderContext &ctx, const Framebuffer &fbo,
+                                       const std::vector<DumpChannel> &channels) {
+    ctx.profiler->beginPass("dump");
+    if (ctx.settings.layout == ShadowMapLayout::Atlas) {
+        ctx.dumper->capture(fbo.handle(), fbo.width(), fbo.height(), channels);
+        return;
+    }
+
+    // One image per cube face
+    std::vector<DumpChannel> faces;
+    for (const auto &ch : channels) {
+        for (int i = 0; i < 6; i++) {
+            DumpChannel face = ch;
+            face.name = ch.name + "_face" + std::to_string(i);
+            face.layer = i;
+            faces.push_back(face);
+        }
+    }
+    ctx.dumper->capture(fbo.handle(), fbo.width(), fbo.height(), faces);
+}
+
+void ShadowTechnique::drawShadowCasters(const RenderContext &ctx, QOpenGLShaderProgram &program) {
+    program.setUniformValue("u_lightPos", ctx.light.position);
+
+    const ClusterCuller culler = ClusterCuller::lightCube(ctx.light.position, ctx.light.nearPlane,
+                                                         ctx.light.farPlane);
+    // rsm.gs clips every face copy to its side planes
+    for (int i = 0; i < 4; i++) {
+        glEnable(GL_CLIP_DISTANCE0 + i);
+    }
+    casterQuery.begin();
+    ctx.scene->draw(program, ctx.settings.clusterCulling ? &culler : nullptr);
+    // The submitted count travels with the query, since the result
+    // arrives frames later when the draw set may have changed
+    casterQuery.end(6 * (GLuint64)ctx.scene->drawnTriangles());
+    for (int i = 0; i < 4; i++) {
+        glDisable(GL_CLIP_DISTANCE0 + i);
+    }
+    shadowClusters = ctx.scene->drawnClusters();
+}
+
+void ShadowTechnique::drawScene(const RenderContext &ctx, QOpenGLShaderProgram &program) {
+    const QVector3D eye = ctx.camera->mvMat().inverted().map(QVector3D(0.0f, 0.0f, 0.0f));
+    const ClusterCuller culler = ClusterCuller::frustum(ctx.camera->mvpMat(), eye);
+    ctx.scene->draw(program, ctx.settings.clusterCulling ? &culler : nullptr);
+    cameraClusters = ctx.scene->drawnClusters();
+}
+
+void ShadowTechnique::updateGBuffer(const RenderContext &ctx) {
+    if (!ctx.settings.deferred) {
+        if (gbufferFbo) {
+            releaseGBuffer();
+            ctx.targetPool->trim();
+        }
+        return;
+    }
+
+    const int width = ctx.viewport[2];
+    const int height = ctx.viewport[3];
+    if (!gbufferShader) {
+        gbufferShader = compileShader(std::string(SOURCE_DIRECTORY) + "shaders/gbuffer");
+    }
+    if (!gbufferFbo || gbufferFbo->width() != width || gbufferFbo->height() != height) {
+        gbufferFbo.reset();
+        gbufferTargets.clear();
+
+        // 32-bit depth for position reconstruction, 8 bytes per pixel besides
+        gbufferTargets = {
+            ctx.targetPool->acquire(RenderTargetDesc::texture2D(width, height, GL_DEPTH_COMPONENT32F)),
+            ctx.targetPool->acquire(RenderTargetDesc::texture2D(width, height, GL_RG16)),
+            ctx.targetPool->acquire(RenderTargetDesc::texture2D(width, height, GL_RGBA8))
+        };
+        gbufferFbo = std::make_unique<Framebuffer>(width, height);
+        gbufferFbo->attach(GL_DEPTH_ATTACHMENT, *gbufferTargets[0]);
+        gbufferFbo->attach(GL_COLOR_ATTACHMENT0, *gbufferTargets[1]);
+        gbufferFbo->attach(GL_COLOR_ATTACHMENT1, *gbufferTargets[2]);
+        gbufferFbo->setDrawBuffers(2);
+        if (!gbufferFbo->isComplete()) {
+            std::cerr << "[ERROR] G-buffer framebuffer is incomplete" << std::endl;
+        }
+
+        ctx.targetPool->trim();
+    }
+
+    ctx.profiler->beginPass("gbuffer");
+    glViewport(0, 0, width, height);
+    gbufferFbo->bind();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    gbufferShader->bind();
+    setSceneUniforms(*gbufferShader, ctx);
+    drawScene(ctx, *gbufferShader);
+    gbufferShader->release();
+    gbufferFbo->release();
+}
+
+void ShadowTechnique::drawDeferred(const RenderContext &ctx, QOpenGLShaderProgram &program) {
+    static const char *samplers[] = { "u_gbufferDepth", "u_gbufferNormal", "u_gbufferAlbedo" };
+    for (int i = 0; i < 3; i++) {
+        glActiveTexture(GL_TEXTURE13 + i);
+        glBindTexture(GL_TEXTURE_2D, gbufferTargets[i]->textureId());
+        program.setUniformValue(samplers[i], 13 + i);
+    }
+    program.setUniformValue("u_invVpMat", ctx.camera->mvpMat().inverted());
+
+    glDisable(GL_DEPTH_TEST);
+    drawFullScreen(ctx);
+    glEnable(GL_DEPTH_TEST);
+}
+
+void ShadowTechnique::releaseGBuffer() {
+    gbufferShader.reset();
+    gbufferFbo.reset();
+    gbufferTargets.clear();
+}
+
+CullStats ShadowTechnique::cullStats() const {
+    CullStats stats;
+    if (casterQuery.hasResult()) {
+        stats.submitted = casterQuery.resultTag();
+        stats.emitted = casterQuery.result();
+    }
+    stats.shadowClusters = shadowClusters;
+    stats.cameraClusters = cameraClusters;
+    return stats;
+}
@@ -0,0 +1,144 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _SHADOW_TECHNIQUE_H_
+#define _SHADOW_TECHNIQUE_H_
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include <QtGui/qopenglfunctions_3_3_core.h>
+#include <QtGui/qopenglshaderprogram.h>
+#include <QtGui/qopenglvertexarrayobject.h>
+#include <QtGui/qmatrix4x4.h>
+
+#include "scene.h"
+#include "arcballcamera.h"
+#include "rendertarget.h"
+#include "shadowmapdumper.h"
+#include "rsmformat.h"
+#include "rendersettings.h"
+#include "gpuquery.h"
+#include "profiler.h"
+
+inline std::vector<std::string> layoutShaderDefines(ShadowMapLayout layout) {
+    if (layout == ShadowMapLayout::Layered) {
+        return { "RSM_LAYERED" };
+    }
+    return {};
+}
+
+// Point light rendered into a cube of six 90-degree perspective views.
+struct LightCube {
+    QVector3D position;
+    QMatrix4x4 projMat;
+    std::vector<QMatrix4x4> viewMat;
+    float nearPlane = 0.05f;
+    float farPlane = 10.0f;
+
+    // Looks down each axis from "pos" with clip planes fit to the scene
+    // box. nearPlane is kept as given unless the whole box lies further away.
+    void setup(const QVector3D &pos, const QVector3D &bboxMin, const QVector3D &bboxMax, float minNear);
+
+    std::vector<QMatrix4x4> vpMat() const {
+        std::vector<QMatrix4x4> ret(viewMat.size());
+        for (int i = 0; i < (int)viewMat.size(); i++) {
+            ret[i] = projMat * viewMat[i];
+        }
+        return ret;
+    }
+
+    std::vector<QMatrix4x4> invVpMat() const {
+        std::vector<QMatrix4x4> ret = vpMat();
+        for (auto &m : ret) {
+            m = m.inverted();
+        }
+        return ret;
+    }
+};
+
+// Per-frame state shared by every technique. The viewer owns everything
+// referenced from here.
+struct RenderContext {
+    Scene *scene = nullptr;
+    ArcballCamera *camera = nullptr;
+    RenderTargetPool *targetPool = nullptr;
+    ShadowMapDumper *dumper = nullptr;
+    QOpenGLVertexArrayObject *emptyVao = nullptr;
+    Profiler *profiler = nullptr;
+
+    LightCube light;
+    int viewport[4] = { 0, 0, 0, 0 };
+
+    RenderSettings settings;
+};
+
+// Geometry stage counters of the shadow pass: copies the six faces would
+// receive without culling versus the triangles actually emitted. The
+// cluster counts are those drawn by the last shadow and camera passes.
+struct CullStats {
+    GLuint64 submitted = 0;
+    GLuint64 emitted = 0;
+    int shadowClusters = 0;
+    int cameraClusters = 0;
+};
+
+// One way of lighting the scene. A technique owns its shaders, render
+// targets and passes; nothing is allocated before initialize() and
+// everything is handed back by release(), so inactive techniques cost
+// nothing.
+class ShadowTechnique : protected QOpenGLFunctions_3_3_Core {
+public:
+    virtual ~ShadowTechnique() {}
+
+    virtual void initialize(const RenderContext &ctx) = 0;
+    virtual void release() = 0;
+
+    // Runs every pass of the technique and draws the lit scene into the
+    // framebuffer that is bound on entry. Each pass starts with
+    // ctx.profiler->beginPass().
+    virtual void render(const RenderContext &ctx) = 0;
+
+    // Zero until the first shadow pass has been measured
+    virtual CullStats cullStats() const;
+
+    // True while the image still improves over successive frames of an
+    // unchanged view; the viewer keeps drawing until it is false
+    virtual bool isConverging() const { return false; }
+
+protected:
+    void setSceneUniforms(QOpenGLShaderProgram &program, const RenderContext &ctx);
+    void drawFullScreen(const RenderContext &ctx);
+
+    // Storage for one shadow map plane in the layout of the context
+    RenderTargetDesc shadowMapDesc(const RenderContext &ctx, GLenum internalFormat) const;
+    void captureShadowMap(const RenderContext &ctx, const Framebuffer &fbo,
+                          const std::vector<DumpChannel> &channels);
+
+    // Draws the scene through rsm.gs and counts the emitted primitives.
+    // Clusters outside the light's reach or facing away from it are skipped.
+    void drawShadowCasters(const RenderContext &ctx, QOpenGLShaderProgram &program);
+
+    // Draws the clusters inside the camera frustum that face the camera
+    void drawScene(const RenderContext &ctx, QOpenGLShaderProgram &program);
+
+    // Deferred shading. With the setting on, updateGBuffer() draws depth,
+    // normal and albedo of the visible surfaces at window size; otherwise
+    // it frees the G-buffer. drawDeferred() runs a program that includes
+    // gbuffer.glsl once per pixel of the bound framebuffer.
+    void updateGBuffer(const RenderContext &ctx);
+    void drawDeferred(const RenderContext &ctx, QOpenGLShaderProgram &program);
+    void releaseGBuffer();
+
+    std::unique_ptr<QOpenGLShaderProgram> gbufferShader = nullptr;
+    std::unique_ptr<Framebuffer> gbufferFbo = nullptr;
+    std::vector<std::shared_ptr<RenderTarget>> gbufferTargets;
+
+    GpuQuery casterQuery = GpuQuery(GL_PRIMITIVES_GENERATED);
+    int shadowClusters = 0;
+    int cameraClusters = 0;
+};
+
+#endif  // _SHADOW_TECHNIQUE_H_
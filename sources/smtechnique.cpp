@@ -0,0 +1,96 @@
+#include "smtechnique.h"
+
+#include <iostream>
+
+#include "common.h"
+#include "glutils.h"
+
+void SmTechnique::initialize(const RenderContext &ctx) {
+    initializeOpenGLFunctions();
+
+    layout = ctx.settings.layout;
+    deferred = ctx.settings.deferred;
+    compileShaders();
+    createTargets(ctx);
+}
+
+void SmTechnique::compileShaders() {
+    auto defines = layoutShaderDefines(layout);
+    defines.push_back("SHADOW_ONLY");
+    depthShader = compileShader(std::string(SOURCE_DIRECTORY) + "shaders/rsm", true, defines);
+    shader = compileShader(std::string(SOURCE_DIRECTORY) + (deferred ? "shaders/deferred" : "shaders/render"),
+                           false, defines);
+}
+
+void SmTechnique::createTargets(const RenderContext &ctx) {
+    depthFbo.reset();
+    depthTarget.reset();
+
+    shadowMapSize = ctx.settings.shadowMapSize;
+    const RenderTargetDesc desc = shadowMapDesc(ctx, GL_DEPTH_COMPONENT32F);
+    depthTarget = ctx.targetPool->acquire(desc);
+    depthFbo = std::make_unique<Framebuffer>(desc.width, desc.height);
+    depthFbo->attach(GL_DEPTH_ATTACHMENT, *depthTarget);
+    depthFbo->setDrawBuffers(0);
+    if (!depthFbo->isComplete()) {
+        std::cerr << "[ERROR] shadow map framebuffer is incomplete" << std::endl;
+    }
+
+    ctx.targetPool->trim();
+}
+
+void SmTechnique::release() {
+    depthShader.reset();
+    shader.reset();
+    depthFbo.reset();
+    depthTarget.reset();
+    releaseGBuffer();
+    casterQuery.release();
+}
+
+void SmTechnique::render(const RenderContext &ctx) {
+    const bool layoutChanged = layout != ctx.settings.layout;
+    if (layoutChanged || deferred != ctx.settings.deferred) {
+        layout = ctx.settings.layout;
+        deferred = ctx.settings.deferred;
+        compileShaders();
+    }
+    if (layoutChanged || shadowMapSize != ctx.settings.shadowMapSize) {
+        createTargets(ctx);
+    }
+
+    // Depth-only pass
+    ctx.profiler->beginPass("shadow");
+    glViewport(0, 0, depthFbo->width(), depthFbo->height());
+    depthFbo->bind();
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    depthShader->bind();
+    depthShader->setUniformValue("u_projMat", ctx.light.projMat);
+    depthShader->setUniformValueArray("u_mvMat", &ctx.light.viewMat[0], 6);
+    drawShadowCasters(ctx, *depthShader);
+    depthShader->release();
+    depthFbo->release();
+
+    if (ctx.dumper->isRequested()) {
+        captureShadowMap(ctx, *depthFbo, { { "depth", GL_DEPTH_ATTACHMENT, GL_DEPTH_COMPONENT } });
+    }
+
+    // Direct lighting
+    updateGBuffer(ctx);
+    ctx.profiler->beginPass(deferred ? "lighting" : "scene");
+    glViewport(ctx.viewport[0], ctx.viewport[1], ctx.viewport[2], ctx.viewport[3]);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    shader->bind();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(depthTarget->desc().target, depthTarget->textureId());
+    shader->setUniformValue("u_depthMap", 0);
+    setSceneUniforms(*shader, ctx);
+    if (deferred) {
+        drawDeferred(ctx, *shader);
+    } else {
+        drawScene(ctx, *shader);
+    }
+    shader->release();
+}
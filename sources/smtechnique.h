@@ -0,0 +1,33 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _SM_TECHNIQUE_H_
+#define _SM_TECHNIQUE_H_
+
+#include <memory>
+
+#include "shadowtechnique.h"
+
+// Plain shadow mapping: one depth-only pass into the cube atlas and
+// direct lighting without any indirect term.
+class SmTechnique : public ShadowTechnique {
+public:
+    void initialize(const RenderContext &ctx) override;
+    void release() override;
+    void render(const RenderContext &ctx) override;
+
+private:
+    void compileShaders();
+    void createTargets(const RenderContext &ctx);
+
+    std::unique_ptr<QOpenGLShaderProgram> depthShader = nullptr;
+    std::unique_ptr<QOpenGLShaderProgram> shader = nullptr;
+    std::unique_ptr<Framebuffer> depthFbo = nullptr;
+    std::shared_ptr<RenderTarget> depthTarget = nullptr;
+    ShadowMapLayout layout = ShadowMapLayout::Atlas;
+    int shadowMapSize = 0;
+    bool deferred = false;
+};
+
+#endif  // _SM_TECHNIQUE_H_
@@ -0,0 +1,62 @@
+#include "stagingring.h"
+
+#include <cstring>
+#include <algorithm>
+
+#include "glutils.h"
+
+StagingRing::StagingRing(size_t segmentBytes, int segmentCount)
+    : segmentBytes_(segmentBytes)
+    , fences_(segmentCount, nullptr) {
+}
+
+size_t StagingRing::copy(GLuint dest, size_t destOffset, const void *src, size_t bytes) {
+    auto f = glCoreFunctions();
+    if (buffer_ == 0) {
+        f->glGenBuffers(1, &buffer_);
+        f->glBindBuffer(GL_COPY_READ_BUFFER, buffer_);
+        f->glBufferData(GL_COPY_READ_BUFFER, segmentBytes_ * fences_.size(), nullptr, GL_STREAM_DRAW);
+    }
+
+    // Segments are reused in order, so the next one is the oldest
+    GLsync &fence = fences_[next_];
+    if (fence) {
+        if (f->glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) return 0;
+        f->glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    const size_t count = std::min(bytes, segmentBytes_);
+    const size_t offset = (size_t)next_ * segmentBytes_;
+    f->glBindBuffer(GL_COPY_READ_BUFFER, buffer_);
+    void *mapped = f->glMapBufferRange(GL_COPY_READ_BUFFER, offset, count,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (!mapped) {
+        f->glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        return 0;
+    }
+    std::memcpy(mapped, src, count);
+    f->glUnmapBuffer(GL_COPY_READ_BUFFER);
+
+    f->glBindBuffer(GL_COPY_WRITE_BUFFER, dest);
+    f->glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, destOffset, count);
+    f->glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    f->glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    fence = f->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    next_ = (next_ + 1) % (int)fences_.size();
+    return count;
+}
+
+void StagingRing::release() {
+    if (buffer_ == 0) return;
+
+    auto f = glCoreFunctions();
+    for (auto &fence : fences_) {
+        if (fence) f->glDeleteSync(fence);
+        fence = nullptr;
+    }
+    f->glDeleteBuffers(1, &buffer_);
+    buffer_ = 0;
+    next_ = 0;
+}
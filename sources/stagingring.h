@@ -0,0 +1,38 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _STAGING_RING_H_
+#define _STAGING_RING_H_
+
+#include <cstddef>
+#include <vector>
+
+#include <QtGui/qopenglfunctions_3_3_core.h>
+
+// Upload buffer split into fixed-size segments, each guarded by a fence.
+// copy() fills a free segment through an unsynchronized mapping and copies
+// it into the destination on the GPU, so large uploads can be spread over
+// frames without the driver stalling on buffers still in use. When every
+// segment is in flight copy() returns 0 instead of waiting.
+class StagingRing {
+public:
+    explicit StagingRing(size_t segmentBytes = 1 << 20, int segmentCount = 8);
+
+    // Copies up to one segment of src into dest at destOffset and returns
+    // the number of bytes copied. The context must be current.
+    size_t copy(GLuint dest, size_t destOffset, const void *src, size_t bytes);
+
+    // Frees the buffer and fences; the context must be current
+    void release();
+
+    inline size_t segmentBytes() const { return segmentBytes_; }
+
+private:
+    size_t segmentBytes_;
+    GLuint buffer_ = 0;
+    std::vector<GLsync> fences_;
+    int next_ = 0;
+};
+
+#endif  // _STAGING_RING_H_
@@ -6,9 +6,274 @@
 
 #include "tinyply.h"
 
+#include <cfloat>
+#include <cmath>
+#include <thread>
+
 using namespace tinyply;
 using namespace std;
 
+namespace
+{
+    bool host_is_big_endian()
+    {
+        const uint16_t probe = 1;
+        return *reinterpret_cast<const uint8_t *>(&probe) == 0;
+    }
+    
+    void swap_scalars(uint8_t * data, size_t count, int stride)
+    {
+        if (stride <= 1) return;
+        for (size_t i = 0; i < count; ++i, data += stride)
+            std::reverse(data, data + stride);
+    }
+    
+    uint32_t read_list_count(PlyProperty::Type t, const uint8_t * src, bool swap)
+    {
+        uint8_t bytes[8];
+        const int stride = PropertyTable[t].stride;
+        std::memcpy(bytes, src, stride);
+        if (swap) swap_scalars(bytes, 1, stride);
+        switch (t)
+        {
+            case PlyProperty::Type::INT8:       return (uint32_t) *reinterpret_cast<int8_t *>(bytes);
+            case PlyProperty::Type::UINT8:      return (uint32_t) *reinterpret_cast<uint8_t *>(bytes);
+            case PlyProperty::Type::INT16:      return (uint32_t) *reinterpret_cast<int16_t *>(bytes);
+            case PlyProperty::Type::UINT16:     return (uint32_t) *reinterpret_cast<uint16_t *>(bytes);
+            case PlyProperty::Type::INT32:      return (uint32_t) *reinterpret_cast<int32_t *>(bytes);
+            case PlyProperty::Type::UINT32:     return (uint32_t) *reinterpret_cast<uint32_t *>(bytes);
+            default:                            throw std::invalid_argument("invalid ply list count type");
+        }
+    }
+    
+    const size_t CHUNK_SIZE = 1 << 20;
+    
+    // Pulls a binary body through one large buffer, so the reader sees
+    // contiguous records instead of issuing an istream::read per scalar.
+    class ChunkReader
+    {
+        
+    public:
+        
+        ChunkReader(std::istream & is) : is(is) {}
+        
+        // Makes at least n bytes available at data(); false at end of stream
+        bool ensure(size_t n)
+        {
+            if (end - pos >= n) return true;
+            const size_t tail = end - pos;
+            if (tail > 0) std::memmove(buffer.data(), buffer.data() + pos, tail);
+            pos = 0;
+            end = tail;
+            if (buffer.size() < std::max(n, CHUNK_SIZE)) buffer.resize(std::max(n, CHUNK_SIZE));
+            is.read(reinterpret_cast<char *>(buffer.data() + end), buffer.size() - end);
+            end += (size_t) is.gcount();
+            return end - pos >= n;
+        }
+        
+        const uint8_t * data() const { return buffer.data() + pos; }
+        size_t available() const { return end - pos; }
+        void consume(size_t n) { pos += n; }
+        
+    private:
+        
+        std::istream & is;
+        std::vector<uint8_t> buffer;
+        size_t pos = 0;
+        size_t end = 0;
+    };
+    
+    // Bytes copied from every record into one destination. Adjacent
+    // properties that share a cursor (x, y, z) are merged into one run.
+    struct CopyRun
+    {
+        uint32_t offset;
+        uint32_t bytes;
+        PlyProperty::Type type;
+        DataCursor * cursor;
+    };
+    
+    // A list whose length was taken from the first record. Records that
+    // disagree are read one at a time.
+    struct ListCheck
+    {
+        uint32_t offset;
+        PlyProperty::Type type;
+        uint32_t count;
+    };
+    
+    // Record layout of one element, computed once before its body is read
+    struct ElementPlan
+    {
+        uint32_t stride = 0;
+        std::vector<CopyRun> runs;
+        std::vector<ListCheck> checks;
+    };
+    
+    void reserve_cursor(DataCursor * cursor, PlyProperty::Type t, size_t bytes)
+    {
+        if (cursor->offset + bytes <= cursor->capacity) return;
+        const int stride = PropertyTable[t].stride;
+        const size_t newCapacity = std::max((size_t) cursor->offset + bytes, cursor->capacity * 2);
+        resize_vector(t, cursor->vector, (int32_t) (newCapacity / stride), cursor->data);
+        cursor->capacity = newCapacity;
+    }
+    
+    void copy_scalars(DataCursor * cursor, const uint8_t * src, uint32_t bytes, int stride, bool swap)
+    {
+        uint8_t * dest = cursor->data + cursor->offset;
+        std::memcpy(dest, src, bytes);
+        if (swap) swap_scalars(dest, bytes / stride, stride);
+        cursor->offset += bytes;
+    }
+    
+    // Below 1 MiB the ASCII body is parsed on the calling thread
+    const size_t MIN_ASCII_CHUNK = 1 << 20;
+    
+    const double POW10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    
+    inline bool is_space(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+    
+    inline const char * skip_space(const char * p, const char * end)
+    {
+        while (p < end && is_space(*p)) ++p;
+        return p;
+    }
+    
+    inline const char * token_end(const char * p, const char * end)
+    {
+        while (p < end && !is_space(*p) && *p != '\n') ++p;
+        return p;
+    }
+    
+    // Locale-independent conversion of one token, in the spirit of
+    // std::from_chars. Advances p on success.
+    bool parse_integer(const char *& p, const char * end, int64_t & value)
+    {
+        const char * s = p;
+        const bool negative = s < end && *s == '-';
+        if (s < end && (*s == '-' || *s == '+')) ++s;
+        if (s == end || *s < '0' || *s > '9') return false;
+        
+        int64_t v = 0;
+        for (; s < end && *s >= '0' && *s <= '9'; ++s) v = v * 10 + (*s - '0');
+        if (token_end(s, end) != s) return false;
+        
+        value = negative ? -v : v;
+        p = s;
+        return true;
+    }
+    
+    // Decimal mantissas below 2^53 with small exponents are converted
+    // exactly (Clinger's fast path). Everything else, and doubles that
+    // would round twice on the way to float, goes through a classic-locale
+    // stream.
+    template<typename T>
+    bool parse_real(const char *& p, const char * end, T & value)
+    {
+        const char * s = p;
+        const bool negative = s < end && *s == '-';
+        if (s < end && (*s == '-' || *s == '+')) ++s;
+        
+        uint64_t mantissa = 0;
+        int digits = 0;
+        int exponent = 0;
+        bool exact = true;
+        bool any = false;
+        for (; s < end && *s >= '0' && *s <= '9'; ++s, any = true)
+        {
+            if (digits < 19) { mantissa = mantissa * 10 + (*s - '0'); if (mantissa) ++digits; }
+            else { exact = false; ++exponent; }
+        }
+        if (s < end && *s == '.')
+        {
+            for (++s; s < end && *s >= '0' && *s <= '9'; ++s, any = true)
+            {
+                if (digits < 19) { mantissa = mantissa * 10 + (*s - '0'); if (mantissa) ++digits; --exponent; }
+                else exact = false;
+            }
+        }
+        if (any && s < end && (*s == 'e' || *s == 'E'))
+        {
+            ++s;
+            int64_t e = 0;
+            if (!parse_integer(s, token_end(s, end), e)) return false;
+            exponent += (int) std::max<int64_t>(-1000, std::min<int64_t>(1000, e));
+        }
+        
+        if (any && token_end(s, end) == s && exact && mantissa < (1ull << 53) && exponent >= -22 && exponent <= 22)
+        {
+            const double magnitude = exponent < 0 ? mantissa / POW10[-exponent] : mantissa * POW10[exponent];
+            const double d = negative ? -magnitude : magnitude;
+            if (std::is_same<T, float>::value && d != 0.0)
+            {
+                // The double is correctly rounded; its float rounding is too
+                // unless it sits exactly halfway between two floats
+                uint64_t bits;
+                std::memcpy(&bits, &d, sizeof(bits));
+                const bool halfway = (bits & 0x1FFFFFFF) == 0x10000000;
+                if (!halfway && magnitude >= FLT_MIN && magnitude <= FLT_MAX)
+                {
+                    value = (T) d;
+                    p = s;
+                    return true;
+                }
+            }
+            else
+            {
+                value = (T) d;
+                p = s;
+                return true;
+            }
+        }
+        
+        const char * e = token_end(p, end);
+        std::istringstream ss(std::string(p, e));
+        ss.imbue(std::locale::classic());
+        ss >> value;
+        if (ss.fail()) return false;
+        p = e;
+        return true;
+    }
+    
+    // Appends one value of the property type to a chunk-local buffer
+    bool parse_value(PlyProperty::Type t, const char *& p, const char * end, std::vector<uint8_t> * out)
+    {
+        p = skip_space(p, end);
+        if (!out)
+        {
+            const char * e = token_end(p, end);
+            if (e == p) return false;
+            p = e;
+            return true;
+        }
+        
+        auto append = [out](const void * v, size_t bytes)
+        {
+            const uint8_t * src = static_cast<const uint8_t *>(v);
+            out->insert(out->end(), src, src + bytes);
+        };
+        
+        int64_t i = 0;
+        switch (t)
+        {
+            case PlyProperty::Type::INT8:       if (!parse_integer(p, end, i)) return false; { int8_t v = (int8_t) i; append(&v, 1); } break;
+            case PlyProperty::Type::UINT8:      if (!parse_integer(p, end, i)) return false; { uint8_t v = (uint8_t) i; append(&v, 1); } break;
+            case PlyProperty::Type::INT16:      if (!parse_integer(p, end, i)) return false; { int16_t v = (int16_t) i; append(&v, 2); } break;
+            case PlyProperty::Type::UINT16:     if (!parse_integer(p, end, i)) return false; { uint16_t v = (uint16_t) i; append(&v, 2); } break;
+            case PlyProperty::Type::INT32:      if (!parse_integer(p, end, i)) return false; { int32_t v = (int32_t) i; append(&v, 4); } break;
+            case PlyProperty::Type::UINT32:     if (!parse_integer(p, end, i)) return false; { uint32_t v = (uint32_t) i; append(&v, 4); } break;
+            case PlyProperty::Type::FLOAT32:    { float v; if (!parse_real(p, end, v)) return false; append(&v, 4); } break;
+            case PlyProperty::Type::FLOAT64:    { double v; if (!parse_real(p, end, v)) return false; append(&v, 8); } break;
+            case PlyProperty::Type::INVALID:    return false;
+        }
+        return true;
+    }
+}
+
 //////////////////
 // PLY Property //
 //////////////////
@@ -96,7 +361,7 @@ void PlyFile::read_header_format(std::istream & is)
     if (s == "binary_little_endian")
         isBinary = true;
     else if (s == "binary_big_endian")
-        throw std::runtime_error("big endian formats are not supported!");
+        isBinary = isBigEndian = true;
 }
 
 void PlyFile::read_header_element(std::istream & is)
@@ -111,18 +376,18 @@ void PlyFile::read_header_property(std::istream & is)
 
 uint32_t PlyFile::skip_property_binary(const PlyProperty & property, std::istream & is)
 {
-    static std::vector<char> skip(PropertyTable[property.propertyType].stride);
+    char skip[8];
     if (property.isList)
     {
         uint32_t listSize = 0;
         uint32_t dummyCount = 0;
         read_property_binary(property.listType, &listSize, dummyCount, is);
-        for (uint32_t i = 0; i < listSize; ++i) is.read(skip.data(), PropertyTable[property.propertyType].stride);
+        for (uint32_t i = 0; i < listSize; ++i) is.read(skip, PropertyTable[property.propertyType].stride);
         return listSize;
     }
     else
     {
-        is.read(skip.data(), PropertyTable[property.propertyType].stride);
+        is.read(skip, PropertyTable[property.propertyType].stride);
         return 0;
     }
 }
@@ -141,18 +406,20 @@ void PlyFile::skip_property_ascii(const PlyProperty & property, std::istream & i
 
 void PlyFile::read_property_binary(PlyProperty::Type t, void * dest, uint32_t & destOffset, std::istream & is)
 {
-    static std::vector<char> src(PropertyTable[t].stride);
-    is.read(src.data(), PropertyTable[t].stride);
+    char src[8];
+    is.read(src, PropertyTable[t].stride);
+    if (isBigEndian != host_is_big_endian())
+        swap_scalars(reinterpret_cast<uint8_t *>(src), 1, PropertyTable[t].stride);
     switch (t)
     {
-        case PlyProperty::Type::INT8:       ply_cast<int8_t>(dest, src.data());    break;
-        case PlyProperty::Type::UINT8:      ply_cast<uint8_t>(dest, src.data());   break;
-        case PlyProperty::Type::INT16:      ply_cast<int16_t>(dest, src.data());   break;
-        case PlyProperty::Type::UINT16:     ply_cast<uint16_t>(dest, src.data());  break;
-        case PlyProperty::Type::INT32:      ply_cast<int32_t>(dest, src.data());   break;
-        case PlyProperty::Type::UINT32:     ply_cast<uint32_t>(dest, src.data());  break;
-        case PlyProperty::Type::FLOAT32:    ply_cast<float>(dest, src.data());     break;
-        case PlyProperty::Type::FLOAT64:    ply_cast<double>(dest, src.data());    break;
+        case PlyProperty::Type::INT8:       ply_cast<int8_t>(dest, src);    break;
+        case PlyProperty::Type::UINT8:      ply_cast<uint8_t>(dest, src);   break;
+        case PlyProperty::Type::INT16:      ply_cast<int16_t>(dest, src);   break;
+        case PlyProperty::Type::UINT16:     ply_cast<uint16_t>(dest, src);  break;
+        case PlyProperty::Type::INT32:      ply_cast<int32_t>(dest, src);   break;
+        case PlyProperty::Type::UINT32:     ply_cast<uint32_t>(dest, src);  break;
+        case PlyProperty::Type::FLOAT32:    ply_cast<float>(dest, src);     break;
+        case PlyProperty::Type::FLOAT64:    ply_cast<double>(dest, src);    break;
         case PlyProperty::Type::INVALID:    throw std::invalid_argument("invalid ply property");
     }
     destOffset += PropertyTable[t].stride;
@@ -199,9 +466,24 @@ void PlyFile::write_property_binary(PlyProperty::Type t, std::ostringstream & os
     srcOffset += PropertyTable[t].stride;
 }
 
-void PlyFile::read(std::istream & is)
+void PlyFile::read(std::istream & is, bool bulk, int maxThreads)
 {
-    read_internal(is);
+    if (!bulk) read_internal(is);
+    else if (isBinary) read_binary_internal(is);
+    else
+    {
+        std::string body;
+        std::vector<char> chunk(CHUNK_SIZE);
+        while (is.read(chunk.data(), chunk.size()) || is.gcount() > 0)
+            body.append(chunk.data(), (size_t) is.gcount());
+        
+        // Bodies that are not one record per line go the slow way
+        if (!read_ascii_internal(body, maxThreads))
+        {
+            std::istringstream bodyStream(body);
+            read_internal(bodyStream);
+        }
+    }
 }
 
 void PlyFile::write(std::ostringstream & os, bool isBinary)
@@ -338,6 +620,7 @@ void PlyFile::read_internal(std::istream & is)
                             {
                                 cursor->realloc = true;
                                 resize_vector(property.propertyType, cursor->vector, listSize * element.size, cursor->data);
+                                cursor->capacity = (size_t) listSize * element.size * PropertyTable[property.propertyType].stride;
                             }
                             for (auto i = 0; i < listSize; ++i)
                             {
@@ -358,4 +641,297 @@ void PlyFile::read_internal(std::istream & is)
         }
         else continue;
     }
-}
\ No newline at end of file
+}
+
+void PlyFile::read_binary_internal(std::istream & is)
+{
+    const bool swap = isBigEndian != host_is_big_endian();
+    ChunkReader reader(is);
+    
+    // Reads one record property by property, for lists whose length differs
+    // from the first record of the element
+    auto read_record = [&](const PlyElement & element, const std::vector<DataCursor *> & cursors)
+    {
+        for (size_t k = 0; k < element.properties.size(); ++k)
+        {
+            const PlyProperty & property = element.properties[k];
+            const int stride = PropertyTable[property.propertyType].stride;
+            uint32_t count = 1;
+            if (property.isList)
+            {
+                const int countStride = PropertyTable[property.listType].stride;
+                if (!reader.ensure(countStride)) throw std::runtime_error("unexpected end of ply file");
+                count = read_list_count(property.listType, reader.data(), swap);
+                reader.consume(countStride);
+            }
+            
+            const uint32_t bytes = count * stride;
+            if (!reader.ensure(bytes)) throw std::runtime_error("unexpected end of ply file");
+            if (DataCursor * cursor = cursors[k])
+            {
+                reserve_cursor(cursor, property.propertyType, bytes);
+                copy_scalars(cursor, reader.data(), bytes, stride, swap);
+            }
+            reader.consume(bytes);
+        }
+    };
+    
+    for (auto & element : get_elements())
+    {
+        if (element.size <= 0) continue;
+        
+        std::vector<DataCursor *> cursors;
+        for (auto & property : element.properties)
+        {
+            auto it = userDataTable.find(make_key(element.name, property.name));
+            cursors.push_back(it != userDataTable.end() ? it->second.get() : nullptr);
+        }
+        
+        // The first record fixes the length of every list
+        ElementPlan plan;
+        std::vector<std::pair<DataCursor *, PlyProperty::Type>> sizedLists;
+        for (size_t k = 0; k < element.properties.size(); ++k)
+        {
+            const PlyProperty & property = element.properties[k];
+            const int stride = PropertyTable[property.propertyType].stride;
+            uint32_t count = 1;
+            if (property.isList)
+            {
+                const int countStride = PropertyTable[property.listType].stride;
+                if (!reader.ensure(plan.stride + countStride)) throw std::runtime_error("unexpected end of ply file");
+                count = read_list_count(property.listType, reader.data() + plan.stride, swap);
+                plan.checks.push_back({ plan.stride, property.listType, count });
+                plan.stride += countStride;
+                
+                DataCursor * cursor = cursors[k];
+                if (cursor && cursor->realloc == false)
+                {
+                    cursor->realloc = true;
+                    resize_vector(property.propertyType, cursor->vector, count * element.size, cursor->data);
+                    cursor->capacity = (size_t) count * element.size * stride;
+                    sizedLists.emplace_back(cursor, property.propertyType);
+                }
+            }
+            
+            const uint32_t bytes = count * stride;
+            if (DataCursor * cursor = cursors[k])
+            {
+                if (!plan.runs.empty() && plan.runs.back().cursor == cursor &&
+                    plan.runs.back().offset + plan.runs.back().bytes == plan.stride &&
+                    plan.runs.back().type == property.propertyType)
+                    plan.runs.back().bytes += bytes;
+                else
+                    plan.runs.push_back({ plan.stride, bytes, property.propertyType, cursor });
+            }
+            plan.stride += bytes;
+        }
+        
+        if (plan.stride == 0) continue;
+        
+        if (plan.checks.empty())
+        {
+            for (const auto & run : plan.runs)
+            {
+                if (run.cursor->offset + (size_t) run.bytes * element.size > run.cursor->capacity)
+                    throw std::runtime_error("destination vector is too small for element: " + element.name);
+            }
+        }
+        
+        const size_t batchSize = std::max<size_t>(1, CHUNK_SIZE / plan.stride);
+        const bool wholeRecord = plan.checks.empty() && plan.runs.size() == 1 && plan.runs[0].bytes == plan.stride;
+        
+        size_t remaining = element.size;
+        while (remaining > 0)
+        {
+            size_t n = std::min(remaining, batchSize);
+            if (!reader.ensure(n * plan.stride))
+            {
+                // Near the end of the file, or records shorter than the first
+                n = reader.available() / plan.stride;
+                if (n == 0)
+                {
+                    read_record(element, cursors);
+                    remaining--;
+                    continue;
+                }
+            }
+            
+            const uint8_t * src = reader.data();
+            if (wholeRecord)
+            {
+                const CopyRun & run = plan.runs[0];
+                copy_scalars(run.cursor, src, (uint32_t) (n * plan.stride), PropertyTable[run.type].stride, swap);
+                reader.consume(n * plan.stride);
+                remaining -= n;
+                continue;
+            }
+            
+            size_t done = 0;
+            bool mismatch = false;
+            for (; done < n; ++done)
+            {
+                const uint8_t * record = src + done * plan.stride;
+                for (const auto & check : plan.checks)
+                {
+                    if (read_list_count(check.type, record + check.offset, swap) != check.count)
+                    {
+                        mismatch = true;
+                        break;
+                    }
+                }
+                if (mismatch) break;
+                
+                for (const auto & run : plan.runs)
+                {
+                    if (!plan.checks.empty()) reserve_cursor(run.cursor, run.type, run.bytes);
+                    copy_scalars(run.cursor, record + run.offset, run.bytes, PropertyTable[run.type].stride, swap);
+                }
+            }
+            
+            reader.consume(done * plan.stride);
+            remaining -= done;
+            if (mismatch)
+            {
+                read_record(element, cursors);
+                remaining--;
+            }
+        }
+        
+        // Lists sized from the first record may have grown past their data
+        for (auto & list : sizedLists)
+        {
+            DataCursor * cursor = list.first;
+            if (cursor->capacity == cursor->offset) continue;
+            resize_vector(list.second, cursor->vector, (int32_t) (cursor->offset / PropertyTable[list.second].stride), cursor->data);
+            cursor->capacity = cursor->offset;
+        }
+    }
+}
+
+bool PlyFile::read_ascii_internal(const std::string & body, int maxThreads)
+{
+    // Destination of every property, as an index into the chunk buffers
+    std::vector<DataCursor *> cursors;
+    std::vector<std::vector<int>> targets;
+    std::vector<int64_t> elementEnd;
+    int64_t records = 0;
+    for (auto & element : get_elements())
+    {
+        std::vector<int> t;
+        for (auto & property : element.properties)
+        {
+            auto it = userDataTable.find(make_key(element.name, property.name));
+            if (it == userDataTable.end()) { t.push_back(-1); continue; }
+            auto c = std::find(cursors.begin(), cursors.end(), it->second.get());
+            t.push_back((int) (c - cursors.begin()));
+            if (c == cursors.end()) cursors.push_back(it->second.get());
+        }
+        targets.push_back(t);
+        records += std::max(0, element.size);
+        elementEnd.push_back(records);
+    }
+    
+    // Line-aligned chunks, one per worker
+    const char * data = body.data();
+    const size_t size = body.size();
+    const size_t threads = maxThreads > 0 ? (size_t) maxThreads : (size_t) std::thread::hardware_concurrency();
+    const size_t nChunks = std::max<size_t>(1, std::min<size_t>(threads, size / MIN_ASCII_CHUNK));
+    std::vector<size_t> bounds(nChunks + 1, size);
+    bounds[0] = 0;
+    for (size_t i = 1; i < nChunks; ++i)
+    {
+        const char * nl = (const char *) std::memchr(data + std::max(bounds[i - 1], size * i / nChunks), '\n', size - std::max(bounds[i - 1], size * i / nChunks));
+        bounds[i] = nl ? (size_t) (nl - data) + 1 : size;
+    }
+    
+    auto run_chunks = [&](const std::function<void(size_t)> & work)
+    {
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < nChunks; ++i) workers.emplace_back(work, i);
+        work(0);
+        for (auto & w : workers) w.join();
+    };
+    
+    // The first line of each chunk gives its element and record
+    std::vector<int64_t> firstLine(nChunks + 1, 0);
+    run_chunks([&](size_t i)
+    {
+        firstLine[i + 1] = std::count(data + bounds[i], data + bounds[i + 1], '\n');
+    });
+    for (size_t i = 0; i < nChunks; ++i) firstLine[i + 1] += firstLine[i];
+    if (size > 0 && data[size - 1] != '\n') firstLine[nChunks]++;
+    if (firstLine[nChunks] < records) return false;
+    
+    std::vector<std::vector<std::vector<uint8_t>>> out(nChunks, std::vector<std::vector<uint8_t>>(cursors.size()));
+    std::vector<char> failed(nChunks, 0);
+    run_chunks([&](size_t i)
+    {
+        for (size_t c = 0; c < cursors.size(); ++c)
+            out[i][c].reserve(cursors[c]->capacity * (bounds[i + 1] - bounds[i]) / std::max<size_t>(1, size) + 1024);
+        
+        const char * p = data + bounds[i];
+        const char * end = data + bounds[i + 1];
+        size_t e = 0;
+        for (int64_t line = firstLine[i]; p < end && line < records; ++line)
+        {
+            while (line >= elementEnd[e]) ++e;
+            const char * lineEnd = (const char *) std::memchr(p, '\n', end - p);
+            if (!lineEnd) lineEnd = end;
+            
+            const PlyElement & element = elements[e];
+            for (size_t k = 0; k < element.properties.size() && !failed[i]; ++k)
+            {
+                const PlyProperty & property = element.properties[k];
+                std::vector<uint8_t> * dest = targets[e][k] >= 0 ? &out[i][targets[e][k]] : nullptr;
+                if (property.isList)
+                {
+                    int64_t count = 0;
+                    p = skip_space(p, lineEnd);
+                    if (!parse_integer(p, lineEnd, count) || count < 0) { failed[i] = 1; break; }
+                    for (int64_t j = 0; j < count; ++j)
+                    {
+                        if (!parse_value(property.propertyType, p, lineEnd, dest)) { failed[i] = 1; break; }
+                    }
+                }
+                else if (!parse_value(property.propertyType, p, lineEnd, dest)) failed[i] = 1;
+            }
+            if (failed[i] || skip_space(p, lineEnd) != lineEnd) { failed[i] = 1; return; }
+            p = lineEnd + 1;
+        }
+    });
+    if (std::find(failed.begin(), failed.end(), 1) != failed.end()) return false;
+    
+    // Stitch the chunks together in file order
+    for (size_t c = 0; c < cursors.size(); ++c)
+    {
+        DataCursor * cursor = cursors[c];
+        size_t bytes = 0;
+        for (size_t i = 0; i < nChunks; ++i) bytes += out[i][c].size();
+        
+        if (cursor->realloc == false && cursor->offset + bytes > cursor->capacity)
+        {
+            // Lists are sized once their total length is known
+            for (size_t e = 0; e < elements.size(); ++e)
+            {
+                for (size_t k = 0; k < elements[e].properties.size(); ++k)
+                {
+                    const PlyProperty & property = elements[e].properties[k];
+                    if (targets[e][k] != (int) c || !property.isList) continue;
+                    resize_vector(property.propertyType, cursor->vector, (int32_t) ((cursor->offset + bytes) / PropertyTable[property.propertyType].stride), cursor->data);
+                    cursor->capacity = cursor->offset + bytes;
+                    cursor->realloc = true;
+                }
+            }
+        }
+        if (cursor->offset + bytes > cursor->capacity)
+            throw std::runtime_error("destination vector is too small for requested properties");
+        
+        for (size_t i = 0; i < nChunks; ++i)
+        {
+            if (out[i][c].empty()) continue;
+            std::memcpy(cursor->data + cursor->offset, out[i][c].data(), out[i][c].size());
+            cursor->offset += (uint32_t) out[i][c].size();
+        }
+    }
+    return true;
+}
@@ -11,6 +11,7 @@
 #include <algorithm>
 #include <string>
 #include <stdint.h>
+#include <cstring>
 #include <map>
 #include <iostream>
 #include <sstream>
@@ -26,6 +27,7 @@ namespace tinyply
         void * vector;
         uint8_t * data;
         uint32_t offset;
+        size_t capacity = 0; // bytes available at data
         bool realloc = false;
     };
     
@@ -184,10 +186,17 @@ namespace tinyply
         PlyFile() {}
         PlyFile(std::istream & is);
         
-        void read(std::istream & is);
+        // Binary bodies go through a bulk reader that copies whole records or
+        // runs of adjacent properties at once. ASCII bodies are split into
+        // line-aligned chunks parsed on up to maxThreads threads, 0 for one
+        // per hardware thread. bulk = false forces the per-value readers,
+        // which are kept for comparison.
+        void read(std::istream & is, bool bulk = true, int maxThreads = 0);
         void write(std::ostringstream & os, bool isBinary);
         
         std::vector<PlyElement> & get_elements() { return elements; }
+        bool is_binary() const { return isBinary; }
+        bool is_big_endian() const { return isBigEndian; }
         
         std::vector<std::string> comments;
         std::vector<std::string> objInfo;
@@ -247,6 +256,7 @@ namespace tinyply
             cursor->offset = 0;
             cursor->vector = &source;
             cursor->data = reinterpret_cast<uint8_t *>(source.data());
+            cursor->capacity = source.size() * sizeof(T);
             
             if (listCount > 1)
             {
@@ -264,6 +274,7 @@ namespace tinyply
             cursor->offset = 0;
             cursor->vector = &source;
             cursor->data = reinterpret_cast<uint8_t *>(source.data());
+            cursor->capacity = source.size() * sizeof(T);
             
             auto create_property_on_element = [&](PlyElement & e)
             {
@@ -309,6 +320,8 @@ namespace tinyply
         void read_header_text(std::string line, std::istream & is, std::vector<std::string> place, int erase = 0);
         
         void read_internal(std::istream & is);
+        void read_binary_internal(std::istream & is);
+        bool read_ascii_internal(const std::string & body, int maxThreads);
         
         void write_ascii_internal(std::ostringstream & os);
         void write_binary_internal(std::ostringstream & os);
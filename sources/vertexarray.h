@@ -5,13 +5,14 @@
 #ifndef _VERTEX_ARRAY_H_
 #define _VERTEX_ARRAY_H_
 
-#include <cstdio>
-#include <cstdlib>
 #include <iostream>
-#include <fstream>
 #include <string>
 #include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstring>
 
+#include <QtCore/qelapsedtimer.h>
 #include <QtGui/qopenglshaderprogram.h>
 #include <QtGui/qopenglvertexarrayobject.h>
 #include <QtGui/qopenglbuffer.h>
@@ -19,14 +20,28 @@
 #include <QtGui/qopenglextrafunctions.h>
 #include <QtGui/qvector3d.h>
 
-#include "tinyply.h"
+#include "glutils.h"
+#include "meshcache.h"
+#include "meshcluster.h"
+#include "meshloader.h"
+#include "stagingring.h"
+#include "vertexformat.h"
 
+// GPU side of a mesh. A mesh prepared by MeshLoader is handed to create(),
+// which allocates the buffers, and its data then follows in chunks through
+// upload(). Clusters are drawn as soon as their indices and vertices have
+// arrived, so a large mesh appears progressively.
 class VertexArray {
 public:
     explicit VertexArray() {
     }
 
     virtual ~VertexArray() {
+        clear();
+    }
+
+    // Frees the GL objects; the context must be current
+    void clear() {
         if (vbo) {
             delete vbo;
             vbo = nullptr;
@@ -41,96 +56,385 @@ public:
             delete vao;
             vao = nullptr;
         }
-    }
 
-    void load(const std::string &filename) {
-        // Load input file.
-        std::ifstream ifs(filename.c_str(), std::ios::in | std::ios::binary);
-        if (!ifs.is_open()) {
-            std::cerr << "[ ERROR ] Failed to open file: " << filename << std::endl;
-            return;
+        if (pointVbo) {
+            delete pointVbo;
+            pointVbo = nullptr;
         }
 
-        tinyply::PlyFile file(ifs);
-        
-        positions_.clear();
-        normals_.clear();
-        colors_.clear();
-        indices_.clear();
-        std::vector<uint8_t> colorBytes;
-
-        file.request_properties_from_element("vertex", {"x", "y", "z"}, positions_);
-        file.request_properties_from_element("vertex", {"nx", "ny", "nz"}, normals_);
-        file.request_properties_from_element("vertex", {"red", "green", "blue", "alpha"}, colorBytes);
-        file.request_properties_from_element("face", {"vertex_indices"}, indices_);
-        
-        file.read(ifs);
-        ifs.close();
-        
-        colors_.resize(colorBytes.size());
-        for (int i = 0; i < colorBytes.size(); i++) {
-            colors_[i] = colorBytes[i] / 255.0f;
+        if (pointVao) {
+            delete pointVao;
+            pointVao = nullptr;
         }
-        
-        // Prepare VAO
+
+        if (instanceVbo) {
+            delete instanceVbo;
+            instanceVbo = nullptr;
+        }
+
+        clusters_.clear();
+        requiredVertices_.clear();
+        readyClusters_ = 0;
+        pending_.reset();
+        cpuMesh_ = MeshData();
+    }
+
+    // Takes over a prepared mesh and allocates its buffers; nothing is
+    // drawn until upload() brings in the data. The context must be current.
+    void create(std::unique_ptr<PreparedMesh> mesh) {
+        clear();
+        uploadTimer_.start();
+
+        filename_ = mesh->filename;
+        layout_ = mesh->layout;
+        format_ = mesh->format;
+        nVertices_ = mesh->vertexCount;
+        indexCount_ = mesh->indexCount;
+        nPointSamples_ = mesh->pointCount;
+        bboxMin_ = mesh->bboxMin;
+        bboxMax_ = mesh->bboxMax;
+        clusters_ = std::move(mesh->clusters);
+        cpuMesh_ = std::move(mesh->cpuMesh);
+        indexType_ = mesh->shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        indexSize_ = mesh->indexSize();
+
+        // Vertices a cluster needs, including those of the clusters before it
+        uint32_t vertexEnd = 0;
+        for (const auto &c : clusters_) {
+            vertexEnd = std::max(vertexEnd, c.vertexEnd);
+            requiredVertices_.push_back(vertexEnd);
+        }
+
         vao = new QOpenGLVertexArrayObject();
         vao->create();
         vao->bind();
-        
+
         vbo = new QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
         vbo->create();
         vbo->setUsagePattern(QOpenGLBuffer::StaticDraw);
         vbo->bind();
-        
-        const size_t totalSize =
-            (positions_.size() + normals_.size()) * sizeof(float) * 3;
-        vbo->allocate(totalSize);
-        
-        unsigned long offset = 0;
-        vbo->write(offset, &positions_[0], positions_.size() * sizeof(float));
-        glEnableVertexAttribArray(POSITION_LOCATION);
-        glVertexAttribPointer(POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, (void*)offset);
-
-        offset += positions_.size() * sizeof(float);
-        vbo->write(offset, &normals_[0], normals_.size() * sizeof(float));
-        glEnableVertexAttribArray(NORMAL_LOCATION);
-        glVertexAttribPointer(NORMAL_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, (void*)offset);
-        
-        offset += normals_.size() * sizeof(float);
-        vbo->write(offset, &colors_[0], colors_.size() * sizeof(float));
-        glEnableVertexAttribArray(COLOR_LOCATION);
-        glVertexAttribPointer(COLOR_LOCATION, 4, GL_FLOAT, GL_FALSE, 0, (void*)offset);
-        
+        allocateBuffer(GL_ARRAY_BUFFER, mesh->vertexBytes());
+        format_.apply();
+
         ibo = new QOpenGLBuffer(QOpenGLBuffer::IndexBuffer);
         ibo->create();
         ibo->setUsagePattern(QOpenGLBuffer::StaticDraw);
         ibo->bind();
-        ibo->allocate(&indices_[0], sizeof(unsigned int) * indices_.size());
-        
+        allocateBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBytes());
+
         vao->release();
+
+        pointVao = new QOpenGLVertexArrayObject();
+        pointVao->create();
+        pointVao->bind();
+
+        pointVbo = new QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+        pointVbo->create();
+        pointVbo->setUsagePattern(QOpenGLBuffer::StaticDraw);
+        pointVbo->bind();
+        allocateBuffer(GL_ARRAY_BUFFER, mesh->pointBytes());
+        VertexFormat::points().apply();
+
+        pointVao->release();
+
+        createInstanceBuffer();
+
+        vertexBytesUploaded_ = 0;
+        indexBytesUploaded_ = 0;
+        pointBytesUploaded_ = 0;
+        pending_ = std::move(mesh);
+    }
+
+    // Copies up to budget bytes of the pending mesh through the ring:
+    // vertices as far as the next cluster needs them, then its indices,
+    // and the point samples last. Returns the bytes copied, less than the
+    // budget once the mesh is complete or the ring is full.
+    size_t upload(StagingRing &ring, size_t budget) {
+        size_t uploaded = 0;
+        while (pending_ && uploaded < budget) {
+            const PreparedMesh &mesh = *pending_;
+            const size_t vertexBytes = mesh.vertexBytes();
+            const size_t neededBytes = readyClusters_ < (int)clusters_.size()
+                ? (size_t)requiredVertices_[readyClusters_] * format_.stride
+                : vertexBytes;
+
+            size_t copied = 0;
+            if (vertexBytesUploaded_ < neededBytes) {
+                copied = ring.copy(vbo->bufferId(), vertexBytesUploaded_,
+                                   mesh.vertices + vertexBytesUploaded_,
+                                   vertexBytes - vertexBytesUploaded_);
+                vertexBytesUploaded_ += copied;
+            } else if (indexBytesUploaded_ < mesh.indexBytes()) {
+                copied = ring.copy(ibo->bufferId(), indexBytesUploaded_,
+                                   mesh.indices.data() + indexBytesUploaded_,
+                                   mesh.indexBytes() - indexBytesUploaded_);
+                indexBytesUploaded_ += copied;
+            } else if (pointBytesUploaded_ < mesh.pointBytes()) {
+                copied = ring.copy(pointVbo->bufferId(), pointBytesUploaded_,
+                                   (const uint8_t *)mesh.points + pointBytesUploaded_,
+                                   mesh.pointBytes() - pointBytesUploaded_);
+                pointBytesUploaded_ += copied;
+            } else {
+                pending_.reset();
+                std::cout << "[ INFO ] Uploaded " << filename_ << " in "
+                          << uploadTimer_.elapsed() << " ms" << std::endl;
+                break;
+            }
+            if (copied == 0) break;
+            uploaded += copied;
+
+            while (readyClusters_ < (int)clusters_.size()) {
+                const MeshCluster &c = clusters_[readyClusters_];
+                if ((size_t)(c.firstIndex + c.indexCount) * indexSize_ > indexBytesUploaded_) break;
+                if ((size_t)requiredVertices_[readyClusters_] * format_.stride > vertexBytesUploaded_) break;
+                readyClusters_++;
+            }
+        }
+        return uploaded;
     }
 
-    void draw(QOpenGLShaderProgram& shader) const {
+    inline bool isCreated() const { return vao != nullptr; }
+    inline bool isUploaded() const { return vao && !pending_; }
+
+    // Fraction of the buffer data on the GPU
+    float uploadProgress() const {
+        if (!vao) return 0.0f;
+        if (!pending_) return 1.0f;
+        const size_t total = pending_->vertexBytes() + pending_->indexBytes() + pending_->pointBytes();
+        const size_t done = vertexBytesUploaded_ + indexBytesUploaded_ + pointBytesUploaded_;
+        return total > 0 ? (float)((double)done / total) : 1.0f;
+    }
+
+    // Model matrices of the copies drawn by draw() and drawPoints(), one
+    // identity instance by default. They are kept across loads.
+    void setInstances(const std::vector<QMatrix4x4> &transforms) {
+        instances_ = transforms;
+        if (instanceVbo) uploadInstances();
+    }
+    inline int instanceCount() const { return (int)instances_.size(); }
+    inline const std::vector<QMatrix4x4> &instances() const { return instances_; }
+
+    // Retained copy with MeshOwnership::KeepCpuCopy, null otherwise
+    inline const MeshData *cpuMesh() const {
+        return vao && !cpuMesh_.positions.empty() ? &cpuMesh_ : nullptr;
+    }
+
+    // Reads the uploaded buffers back from the GPU. This stalls until the
+    // buffers are available; the context must be current. Quantized
+    // layouts return the quantized values.
+    bool readback(MeshData *mesh) const {
+        if (!isUploaded()) return false;
+
+        std::vector<uint8_t> vertices((size_t)nVertices_ * format_.stride);
+        std::vector<uint8_t> clustered((size_t)indexCount_ * indexSize_);
+
+        // The IBO binding belongs to the VAO
+        auto f = glCoreFunctions();
         vao->bind();
+        vbo->bind();
+        f->glGetBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)vertices.size(), vertices.data());
+        vbo->release();
+        f->glGetBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, (GLsizeiptr)clustered.size(), clustered.data());
+        vao->release();
+        if (f->glGetError() != GL_NO_ERROR) {
+            std::cerr << "[ERROR] failed to read back mesh buffers" << std::endl;
+            return false;
+        }
+
+        // Undo the per-cluster base vertices
+        std::vector<unsigned int> indices(indexCount_);
+        for (const auto &c : clusters_) {
+            for (uint32_t i = c.firstIndex; i < c.firstIndex + c.indexCount; i++) {
+                const unsigned int local = indexType_ == GL_UNSIGNED_SHORT
+                    ? ((const uint16_t *)clustered.data())[i]
+                    : ((const uint32_t *)clustered.data())[i];
+                indices[i] = local + (unsigned int)c.baseVertex;
+            }
+        }
+
+        MeshLoader::decodeMesh(format_, vertices.data(), nVertices_, (const uint8_t *)indices.data(),
+                               3 * sizeof(unsigned int), indexCount_, mesh);
+        return true;
+    }
+
+    // Reads the loaded mesh again from its cache or source file, at full
+    // precision unless only a quantized cache is available
+    bool reload(MeshData *mesh) const {
+        if (filename_.empty()) return false;
 
-        glDrawElements(GL_TRIANGLES, indices_.size(), GL_UNSIGNED_INT, 0);
+        MeshCache cache(filename_);
+        if (cache.open()) {
+            const MeshCacheHeader &header = cache.header();
+            MeshLoader::decodeMesh(cache.format(), cache.vertices(), (int)header.vertexCount, cache.indices(),
+                                   3 * sizeof(unsigned int), (int)header.indexCount, mesh);
+            return true;
+        }
+        return MeshLoader::parsePly(filename_, mesh);
+    }
+
+    // Draws the uploaded clusters the culler passes for any instance, or
+    // all of them, in one multi-draw for a single instance and one
+    // instanced draw per cluster run otherwise. The shader must be bound;
+    // it receives the position decode of the vertex layout.
+    void draw(QOpenGLShaderProgram& shader, const ClusterCuller *culler = nullptr) const {
+        if (!vao || instances_.empty()) return;
+
+        shader.setUniformValue("u_positionOffset", format_.positionOffset);
+        shader.setUniformValue("u_positionScale", format_.positionScale);
+
+        instanceCullers_.clear();
+        if (culler) {
+            for (const auto &m : instances_) {
+                instanceCullers_.push_back(culler->transformed(m));
+            }
+        }
+
+        drawCounts_.clear();
+        drawOffsets_.clear();
+        drawBaseVertices_.clear();
+        drawnClusters_ = 0;
+        drawnTriangles_ = 0;
+        uint32_t lastEnd = 0;
+        for (int i = 0; i < readyClusters_; i++) {
+            const MeshCluster &c = clusters_[i];
+            if (culler && !isVisible(c)) continue;
+            drawnClusters_++;
+            drawnTriangles_ += c.indexCount / 3 * (int)instances_.size();
+
+            // Neighbours sharing a base vertex go into one draw
+            if (!drawCounts_.empty() && lastEnd == c.firstIndex && drawBaseVertices_.back() == c.baseVertex) {
+                drawCounts_.back() += c.indexCount;
+            } else {
+                drawCounts_.push_back((GLsizei)c.indexCount);
+                drawOffsets_.push_back((const void *)((size_t)c.firstIndex * indexSize_));
+                drawBaseVertices_.push_back(c.baseVertex);
+            }
+            lastEnd = c.firstIndex + c.indexCount;
+        }
+        if (drawCounts_.empty()) return;
+
+        vao->bind();
+
+        auto f = glCoreFunctions();
+        if (instances_.size() == 1) {
+            f->glMultiDrawElementsBaseVertex(GL_TRIANGLES, drawCounts_.data(), indexType_,
+                                             drawOffsets_.data(), (GLsizei)drawCounts_.size(),
+                                             drawBaseVertices_.data());
+        } else {
+            for (size_t i = 0; i < drawCounts_.size(); i++) {
+                f->glDrawElementsInstancedBaseVertex(GL_TRIANGLES, drawCounts_[i], indexType_, drawOffsets_[i],
+                                                     (GLsizei)instances_.size(), drawBaseVertices_[i]);
+            }
+        }
 
         vao->release();
     }
 
+    // Point-sampled copy of the surface, used to splat imperfect shadow
+    // maps. Nothing is drawn before the upload is complete.
+    void drawPoints() const {
+        if (!isUploaded() || instances_.empty()) return;
+
+        pointVao->bind();
+
+        glCoreFunctions()->glDrawArraysInstanced(GL_POINTS, 0, nPointSamples_, (GLsizei)instances_.size());
+
+        pointVao->release();
+    }
+
+    inline int pointCount() const { return nPointSamples_; }
+    inline int triangleCount() const { return indexCount_ / 3; }
+    inline int clusterCount() const { return (int)clusters_.size(); }
+
+    // What the last draw() submitted
+    inline int drawnClusters() const { return drawnClusters_; }
+    inline int drawnTriangles() const { return drawnTriangles_; }
+    inline VertexLayout layout() const { return layout_; }
+
+    inline QVector3D bboxMin() const { return bboxMin_; }
+    inline QVector3D bboxMax() const { return bboxMax_; }
+    inline float boundingRadius() const { return 0.5f * (bboxMax_ - bboxMin_).length(); }
+
+private:
+    inline bool isVisible(const MeshCluster &cluster) const {
+        for (const auto &culler : instanceCullers_) {
+            if (culler.isVisible(cluster)) return true;
+        }
+        return false;
+    }
+
+    // One mat4 per instance, read by both VAOs
+    void createInstanceBuffer() {
+        instanceVbo = new QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+        instanceVbo->create();
+        instanceVbo->setUsagePattern(QOpenGLBuffer::DynamicDraw);
+        uploadInstances();
+
+        for (QOpenGLVertexArrayObject *array : { vao, pointVao }) {
+            array->bind();
+            instanceVbo->bind();
+            VertexFormat::applyInstanceTransform();
+            array->release();
+        }
+        instanceVbo->release();
+    }
+
+    // QOpenGLBuffer::allocate() takes an int byte count, which meshes over
+    // 2 GiB overflow. The buffer must be bound.
+    static void allocateBuffer(GLenum target, size_t bytes) {
+        glCoreFunctions()->glBufferData(target, (GLsizeiptr)bytes, nullptr, GL_STATIC_DRAW);
+    }
+
+    void uploadInstances() {
+        std::vector<float> data(instances_.size() * 16);
+        for (size_t i = 0; i < instances_.size(); i++) {
+            std::memcpy(&data[i * 16], instances_[i].constData(), 16 * sizeof(float));
+        }
+        instanceVbo->bind();
+        instanceVbo->allocate(data.data(), (int)(data.size() * sizeof(float)));
+        instanceVbo->release();
+    }
+
 private:
     QOpenGLVertexArrayObject *vao = nullptr;
     QOpenGLBuffer *vbo = nullptr;
     QOpenGLBuffer *ibo = nullptr;
-    
-    std::vector<float> positions_;
-    std::vector<float> normals_;
-    std::vector<float> colors_;
-    std::vector<unsigned int> indices_;
-
-    static constexpr int POSITION_LOCATION = 0;
-    static constexpr int NORMAL_LOCATION   = 1;
-    static constexpr int COLOR_LOCATION    = 2;
+
+    QOpenGLVertexArrayObject *pointVao = nullptr;
+    QOpenGLBuffer *pointVbo = nullptr;
+    QOpenGLBuffer *instanceVbo = nullptr;
+    std::vector<QMatrix4x4> instances_ = { QMatrix4x4() };
+    mutable std::vector<ClusterCuller> instanceCullers_;
+    int nPointSamples_ = 0;
+
+    QVector3D bboxMin_;
+    QVector3D bboxMax_;
+    int nVertices_ = 0;
+    int indexCount_ = 0;
+    VertexLayout layout_ = VertexLayout::Float;
+    VertexFormat format_;
+    std::string filename_;
+
+    std::vector<MeshCluster> clusters_;
+    GLenum indexType_ = GL_UNSIGNED_INT;
+    size_t indexSize_ = sizeof(uint32_t);
+
+    // Draw lists, rebuilt by every draw()
+    mutable std::vector<GLsizei> drawCounts_;
+    mutable std::vector<const void *> drawOffsets_;
+    mutable std::vector<GLint> drawBaseVertices_;
+    mutable int drawnClusters_ = 0;
+    mutable int drawnTriangles_ = 0;
+    MeshData cpuMesh_;
+
+    // Upload state; the prepared mesh is released once it is complete
+    std::unique_ptr<PreparedMesh> pending_;
+    std::vector<uint32_t> requiredVertices_;
+    int readyClusters_ = 0;
+    size_t vertexBytesUploaded_ = 0;
+    size_t indexBytesUploaded_ = 0;
+    size_t pointBytesUploaded_ = 0;
+    QElapsedTimer uploadTimer_;
 };
 
 #endif  // _VERTEX_ARRAY_H_
@@ -0,0 +1,184 @@
+#include "vertexformat.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "glutils.h"
+
+namespace {
+
+// Attribute locations shared by the scene shaders
+const uint32_t POSITION_LOCATION = 0;
+const uint32_t NORMAL_LOCATION   = 1;
+const uint32_t COLOR_LOCATION    = 2;
+const uint32_t INSTANCE_LOCATION = 3;
+
+inline float clampUnit(float v) {
+    return std::max(-1.0f, std::min(1.0f, v));
+}
+
+void encodeScalars(uint8_t *dest, const VertexAttribute &a, const float *v) {
+    switch (a.type) {
+    case GL_FLOAT:
+        std::memcpy(dest, v, a.components * sizeof(float));
+        break;
+
+    case GL_SHORT:
+        for (uint32_t k = 0; k < a.components; k++) {
+            const int16_t q = (int16_t)std::lround(clampUnit(v[k]) * 32767.0f);
+            std::memcpy(dest + k * sizeof(int16_t), &q, sizeof(int16_t));
+        }
+        break;
+
+    case GL_INT_2_10_10_10_REV: {
+        uint32_t packed = 0;
+        for (uint32_t k = 0; k < std::min(a.components, 3u); k++) {
+            const int32_t q = (int32_t)std::lround(clampUnit(v[k]) * 511.0f);
+            packed |= ((uint32_t)q & 0x3FF) << (10 * k);
+        }
+        std::memcpy(dest, &packed, sizeof(packed));
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+void decodeScalars(const uint8_t *src, const VertexAttribute &a, float *v) {
+    switch (a.type) {
+    case GL_FLOAT:
+        std::memcpy(v, src, a.components * sizeof(float));
+        break;
+
+    case GL_SHORT:
+        for (uint32_t k = 0; k < a.components; k++) {
+            int16_t q;
+            std::memcpy(&q, src + k * sizeof(int16_t), sizeof(int16_t));
+            v[k] = std::max(-1.0f, q / 32767.0f);
+        }
+        break;
+
+    case GL_INT_2_10_10_10_REV: {
+        uint32_t packed;
+        std::memcpy(&packed, src, sizeof(packed));
+        for (uint32_t k = 0; k < std::min(a.components, 3u); k++) {
+            // Sign-extend the 10-bit field
+            const int32_t q = (int32_t)(packed << (22 - 10 * k)) >> 22;
+            v[k] = std::max(-1.0f, q / 511.0f);
+        }
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+}  // anonymous namespace
+
+VertexFormat VertexFormat::create(VertexLayout layout, const QVector3D &bboxMin, const QVector3D &bboxMax) {
+    VertexFormat format;
+    if (layout == VertexLayout::Quantized) {
+        format.stride = 16;
+        format.attributes = {
+            { VertexSemantic::Position, POSITION_LOCATION, 3, GL_SHORT, 1, 0 },
+            { VertexSemantic::Normal, NORMAL_LOCATION, 4, GL_INT_2_10_10_10_REV, 1, 8 },
+            { VertexSemantic::Color, COLOR_LOCATION, 4, GL_UNSIGNED_BYTE, 1, 12 }
+        };
+
+        // Keep the scale away from zero for flat meshes
+        format.positionOffset = 0.5f * (bboxMin + bboxMax);
+        format.positionScale = 0.5f * (bboxMax - bboxMin);
+        for (int k = 0; k < 3; k++) {
+            format.positionScale[k] = std::max(format.positionScale[k], 1.0e-6f);
+        }
+    } else {
+        format.stride = 28;
+        format.attributes = {
+            { VertexSemantic::Position, POSITION_LOCATION, 3, GL_FLOAT, 0, 0 },
+            { VertexSemantic::Normal, NORMAL_LOCATION, 3, GL_FLOAT, 0, 12 },
+            { VertexSemantic::Color, COLOR_LOCATION, 4, GL_UNSIGNED_BYTE, 1, 24 }
+        };
+    }
+    return format;
+}
+
+VertexFormat VertexFormat::points() {
+    VertexFormat format;
+    format.stride = 3 * sizeof(float);
+    format.attributes = {
+        { VertexSemantic::Position, POSITION_LOCATION, 3, GL_FLOAT, 0, 0 }
+    };
+    return format;
+}
+
+void VertexFormat::encode(uint8_t *record, const float *position, const float *normal, const uint8_t *color) const {
+    static const float zero[3] = { 0.0f, 0.0f, 0.0f };
+    static const uint8_t white[4] = { 255, 255, 255, 255 };
+
+    for (const auto &a : attributes) {
+        uint8_t *dest = record + a.offset;
+        switch (a.semantic) {
+        case VertexSemantic::Position: {
+            float p[3];
+            for (int k = 0; k < 3; k++) {
+                p[k] = (position[k] - positionOffset[k]) / positionScale[k];
+            }
+            encodeScalars(dest, a, p);
+            break;
+        }
+
+        case VertexSemantic::Normal:
+            encodeScalars(dest, a, normal ? normal : zero);
+            break;
+
+        case VertexSemantic::Color:
+            std::memcpy(dest, color ? color : white, a.components);
+            break;
+        }
+    }
+}
+
+void VertexFormat::decode(const uint8_t *record, float *position, float *normal, uint8_t *color) const {
+    for (const auto &a : attributes) {
+        const uint8_t *src = record + a.offset;
+        switch (a.semantic) {
+        case VertexSemantic::Position:
+            decodeScalars(src, a, position);
+            for (int k = 0; k < 3; k++) {
+                position[k] = positionOffset[k] + positionScale[k] * position[k];
+            }
+            break;
+
+        case VertexSemantic::Normal:
+            decodeScalars(src, a, normal);
+            break;
+
+        case VertexSemantic::Color:
+            std::memcpy(color, src, a.components);
+            break;
+        }
+    }
+}
+
+void VertexFormat::apply() const {
+    auto f = glCoreFunctions();
+    for (const auto &a : attributes) {
+        f->glEnableVertexAttribArray(a.location);
+        f->glVertexAttribPointer(a.location, a.components, a.type, a.normalized ? GL_TRUE : GL_FALSE,
+                                 stride, (void*)(size_t)a.offset);
+    }
+}
+
+void VertexFormat::applyInstanceTransform() {
+    auto f = glCoreFunctions();
+    for (uint32_t col = 0; col < 4; col++) {
+        const uint32_t location = INSTANCE_LOCATION + col;
+        f->glEnableVertexAttribArray(location);
+        f->glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float),
+                                 (void*)(size_t)(col * 4 * sizeof(float)));
+        f->glVertexAttribDivisor(location, 1);
+    }
+}
@@ -0,0 +1,68 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _VERTEX_FORMAT_H_
+#define _VERTEX_FORMAT_H_
+
+#include <cstdint>
+#include <vector>
+
+#include <QtGui/qvector3d.h>
+
+// How mesh vertices are stored on the GPU.
+//   Float:     float3 position, float3 normal, ubyte4 color (28 bytes)
+//   Quantized: snorm16 position relative to the mesh bounds, 10-10-10-2
+//              normal, ubyte4 color (16 bytes)
+enum class VertexLayout : int {
+    Float = 0x01,
+    Quantized = 0x02
+};
+
+enum class VertexSemantic : uint32_t {
+    Position = 0,
+    Normal = 1,
+    Color = 2
+};
+
+// One attribute of an interleaved vertex record. The fields are plain
+// 32-bit values so the description can be stored in mesh caches as is.
+struct VertexAttribute {
+    VertexSemantic semantic;
+    uint32_t location;
+    uint32_t components;
+    uint32_t type;
+    uint32_t normalized;
+    uint32_t offset;
+};
+
+// Layout of the interleaved vertex records in a VBO. Stored positions p
+// decode to positionOffset + positionScale * p in the vertex shaders
+// (see vertex.glsl).
+struct VertexFormat {
+    uint32_t stride = 0;
+    std::vector<VertexAttribute> attributes;
+    QVector3D positionOffset = QVector3D(0.0f, 0.0f, 0.0f);
+    QVector3D positionScale = QVector3D(1.0f, 1.0f, 1.0f);
+
+    // Format of the given layout. Quantized positions cover the bounds.
+    static VertexFormat create(VertexLayout layout, const QVector3D &bboxMin, const QVector3D &bboxMax);
+
+    // Bare float positions, as used for point samples
+    static VertexFormat points();
+
+    // Writes one record; normal and color may be null
+    void encode(uint8_t *record, const float *position, const float *normal, const uint8_t *color) const;
+
+    // Reads one record back, up to the precision of the layout
+    void decode(const uint8_t *record, float *position, float *normal, uint8_t *color) const;
+
+    // Sets the attribute pointers for the bound VAO and VBO
+    void apply() const;
+
+    // Per-instance mat4 model matrices from the bound VBO, one column per
+    // attribute location from 3 on
+    static void applyInstanceTransform();
+};
+
+#endif  // _VERTEX_FORMAT_H_